@@ -0,0 +1,552 @@
+///@file   column-export.hpp
+///@author Chris Newman
+///@brief  Streams snapshots of component arrays to columnar files on a
+///        background thread, for offline analysis.
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "world.hpp"
+
+///@brief Element types of exported columns.
+enum class ColumnType : uint8_t
+{
+  bytes, ///< Opaque fixed-size values, such as whole components.
+  u8, i8, u16, i16, u32, i32, u64, i64,
+  f32, f64
+};
+
+namespace __detail
+{
+  ///@brief Column type of an arithmetic or enum field type.
+  template<typename T>
+  constexpr ColumnType column_type()
+  {
+    if constexpr (std::is_enum_v<T>)
+      return column_type<std::underlying_type_t<T>>();
+    else if constexpr (std::is_floating_point_v<T>)
+      return sizeof(T) == 4 ? ColumnType::f32 : sizeof(T) == 8 ? ColumnType::f64 : ColumnType::bytes;
+    else if constexpr (std::is_integral_v<T>)
+    {
+      constexpr bool s = std::is_signed_v<T>;
+      switch (sizeof(T))
+      {
+      case 1: return s ? ColumnType::i8 : ColumnType::u8;
+      case 2: return s ? ColumnType::i16 : ColumnType::u16;
+      case 4: return s ? ColumnType::i32 : ColumnType::u32;
+      case 8: return s ? ColumnType::i64 : ColumnType::u64;
+      default: return ColumnType::bytes;
+      }
+    }
+    else
+      return ColumnType::bytes;
+  }
+
+  // TColumnExporter ////////////////////////////////////////////////////////////
+  ///@brief Writes snapshots of component arrays to a series of columnar
+  ///       files. Each exported component type is a table with an entity id
+  ///       column followed by one column per listed field, or a single
+  ///       column holding whole components.
+  ///
+  ///       `capture` copies the tables on the calling thread, in bulk where
+  ///       the arrays allow it, and a background thread writes the copy. Whole
+  ///       components and ids go to the file straight from the copy, without
+  ///       any formatting. When the writer falls behind, captures are skipped
+  ///       rather than stalling the tick.
+  ///
+  ///       Files are named `<prefix>-NNNNNN.cols` and start a new one once
+  ///       they pass a size limit. Every value is in host byte order. A file
+  ///       is a header followed by chunks, one per capture:
+  ///       - Header: the magic `ECSCOLS1`, then u32 size of an entity id, u32
+  ///         table count, and per table a string name and u32 column count,
+  ///         then per column a string name, u8 `ColumnType` and u32 size of
+  ///         one value. Strings are a u32 length followed by the characters.
+  ///         The header is padded to 8 bytes.
+  ///       - Chunk: the magic `CHNK`, u32 padding, u64 size of the chunk
+  ///         after this field, u64 stamp passed to `capture`, then per table
+  ///         a u64 row count, the id column and each column. Columns are
+  ///         padded to 8 bytes, so every column starts 8-byte aligned in
+  ///         the file and can be mapped in place.
+  template<typename ID_T>
+  class TColumnExporter
+  {
+  public:
+    /// Default size after which a new file is started.
+    static constexpr uint64_t defaultFileSize = uint64_t{ 256 } << 20;
+
+    ///@param world      The world to export. Must outlive the exporter.
+    ///@param prefix     Path of the files, without the number and extension.
+    ///@param fileSize   Size after which a new file is started. A chunk is
+    ///                  never split, so files can be larger.
+    ///@param maxPending Captures that may wait for the writer. Further
+    ///                  captures are skipped until it catches up.
+    TColumnExporter(TWorld<ID_T>& world, std::string prefix,
+      uint64_t fileSize = defaultFileSize, size_t maxPending = 2);
+    TColumnExporter(TColumnExporter const&) = delete;
+    TColumnExporter& operator=(TColumnExporter const&) = delete;
+    ///@brief Writes the pending captures and closes the file.
+    ~TColumnExporter();
+
+    ///@brief      Exports the components of type `COMP` as a table. Unless
+    ///            fields are listed with `column`, trivially copyable types
+    ///            get one `bytes` column of whole components. Other types
+    ///            must list their fields, and empty types only export their
+    ///            ids.
+    ///@param name Name of the table.
+    template<typename COMP>
+    TColumnExporter& table(std::string name);
+
+    ///@brief      Exports the member `FIELD` as a column of the table of its
+    ///            component type, as in `column<&Pos::x>("x")`. The table must
+    ///            have been added. The field must be trivially copyable.
+    ///@param name Name of the column.
+    template<auto FIELD>
+    TColumnExporter& column(std::string name);
+
+    ///@brief       Copies the tables and hands the copy to the writer. Must be
+    ///             called from the thread that owns the world. Tables and
+    ///             columns can not be added after the first capture.
+    ///             Once the writer ran into an error, the export is stopped
+    ///             and this and every later call rethrow it.
+    ///@param stamp Stored in the chunk, such as the tick number.
+    ///@return      False if the capture was skipped because the writer is
+    ///             behind.
+    bool capture(uint64_t stamp);
+
+    ///@brief Waits until every capture so far is written and flushed to the
+    ///       file. Rethrows the writer error, as `capture` does.
+    void flush();
+
+    ///@return Number of captures skipped because the writer was behind.
+    size_t skipped() const { return skipped_; }
+
+  private:
+    struct Column
+    {
+      std::string name;
+      ColumnType  type;
+      uint32_t    size;
+      uint32_t    offset; ///< Of the field in the component.
+    };
+
+    struct TableSnap
+    {
+      std::vector<ID_T>      ids;
+      std::vector<std::byte> data; ///< Whole components, or each column.
+    };
+
+    struct Table
+    {
+      uint32_t            key;
+      std::string         name;
+      bool                whole;    ///< One column of whole components.
+      bool                copyable; ///< Data is copied as whole components.
+      uint32_t            compSize;
+      std::vector<Column> columns;
+
+      void (*capture)(TWorld<ID_T>& world, Table const& table, TableSnap& snap);
+    };
+
+    struct Snapshot
+    {
+      uint64_t               stamp;
+      std::vector<TableSnap> tables;
+    };
+
+    template<typename COMP>
+    Table& find_table();
+
+    ///@brief Writer thread loop.
+    void run();
+    ///@brief Writes one snapshot as a chunk, starting a new file if needed.
+    void write(Snapshot const& snap);
+    void open_file();
+    void put(void const* data, size_t size);
+    void put_u32(uint32_t v) { put(&v, sizeof(v)); }
+    void put_string(std::string const& s);
+    void pad(size_t size);
+
+    TWorld<ID_T>&                          world_;
+    std::string                            prefix_;
+    uint64_t                               fileSize_;
+    size_t                                 maxPending_;
+    std::vector<Table>                     tables_;
+    bool                                   started_ = false;
+    size_t                                 skipped_ = 0;
+
+    std::mutex                             mutex_;
+    std::condition_variable                wake_;
+    std::condition_variable                done_;
+    std::deque<std::unique_ptr<Snapshot>>  queue_;
+    std::vector<std::unique_ptr<Snapshot>> free_;
+    size_t                                 pending_ = 0; ///< Queued or being written.
+    bool                                   stop_ = false;
+    std::exception_ptr                     error_; ///< First writer error, kept.
+    std::thread                            thread_;
+
+    // Only used by the writer thread.
+    bool                                   failed_ = false;
+    std::FILE*                             file_ = nullptr;
+    uint32_t                               fileIndex_ = 0;
+    uint64_t                               fileBytes_ = 0;
+    std::vector<std::byte>                 scratch_;
+  };
+
+  template<typename ID_T>
+  TColumnExporter<ID_T>::TColumnExporter(TWorld<ID_T>& world, std::string prefix, uint64_t fileSize, size_t maxPending)
+    : world_{ world }, prefix_{ std::move(prefix) }, fileSize_{ fileSize }, maxPending_{ maxPending > 0 ? maxPending : 1 } {}
+
+  template<typename ID_T>
+  TColumnExporter<ID_T>::~TColumnExporter()
+  {
+    if (thread_.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        stop_ = true;
+      }
+      wake_.notify_one();
+      thread_.join();
+    }
+    if (file_ != nullptr)
+      std::fclose(file_);
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  typename TColumnExporter<ID_T>::Table& TColumnExporter<ID_T>::find_table()
+  {
+    uint32_t const key = get_type_id<COMP, ComponentFamily>();
+    for (Table& t : tables_)
+    {
+      if (t.key == key)
+        return t;
+    }
+    throw std::runtime_error{ "Component type has no table!" };
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  TColumnExporter<ID_T>& TColumnExporter<ID_T>::table(std::string name)
+  {
+    if (started_)
+      throw std::runtime_error{ "Export schema is fixed after the first capture!" };
+
+    uint32_t const key = get_type_id<COMP, ComponentFamily>();
+    for (Table const& t : tables_)
+    {
+      if (t.key == key)
+        throw std::runtime_error{ "Component type already has a table!" };
+    }
+
+    Table t{};
+    t.key = key;
+    t.name = std::move(name);
+    t.copyable = std::is_trivially_copyable_v<COMP> && !std::is_empty_v<COMP>;
+    t.whole = t.copyable;
+    t.compSize = std::is_empty_v<COMP> ? 0 : static_cast<uint32_t>(sizeof(COMP));
+    if (t.whole)
+      t.columns.push_back(Column{ "value", ColumnType::bytes, t.compSize, 0 });
+
+    // Captures only read, so double-buffered types are not marked as
+    // written.
+    t.capture = [](TWorld<ID_T>& world, Table const& table, TableSnap& snap)
+    {
+      TArrayView<ID_T> ids = world.template comp_get_entities<COMP>();
+      size_t const rows = ids.size();
+      snap.ids.assign(ids.begin(), ids.end());
+
+      if constexpr (!std::is_empty_v<COMP>)
+      {
+        if constexpr (std::is_trivially_copyable_v<COMP>)
+        {
+          // Whole components, split into columns by the writer if needed.
+          snap.data.resize(rows * sizeof(COMP));
+          if constexpr (comp_layout_v<COMP> == CompLayout::packed)
+          {
+            if (rows > 0)
+              std::memcpy(snap.data.data(), world.template comp_get<COMP>().data(), rows * sizeof(COMP));
+          }
+          else
+          {
+            for (size_t i = 0; i < rows; ++i)
+              std::memcpy(snap.data.data() + i * sizeof(COMP), world.template comp_latest<COMP>(ids[i]), sizeof(COMP));
+          }
+        }
+        else
+        {
+          // Only the listed fields can be copied, straight into columns.
+          size_t total = 0;
+          for (Column const& c : table.columns)
+            total += c.size;
+          snap.data.resize(rows * total);
+          for (size_t i = 0; i < rows; ++i)
+          {
+            std::byte const* comp = reinterpret_cast<std::byte const*>(world.template comp_latest<COMP>(ids[i]));
+            std::byte* out = snap.data.data();
+            for (Column const& c : table.columns)
+            {
+              std::memcpy(out + i * c.size, comp + c.offset, c.size);
+              out += rows * c.size;
+            }
+          }
+        }
+      }
+    };
+    tables_.push_back(std::move(t));
+    return *this;
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  TColumnExporter<ID_T>& TColumnExporter<ID_T>::column(std::string name)
+  {
+    using Comp = FieldCompT<FIELD>;
+    using Key = FieldKeyT<FIELD>;
+    static_assert(std::is_trivially_copyable_v<Key>, "Exported fields must be trivially copyable.");
+
+    if (started_)
+      throw std::runtime_error{ "Export schema is fixed after the first capture!" };
+    Table& t = find_table<Comp>();
+    if (t.whole)
+    {
+      // Listing a field replaces the whole-component column.
+      t.whole = false;
+      t.columns.clear();
+    }
+
+    // The offset is taken from storage that is never constructed into, only
+    // used for address arithmetic.
+    alignas(Comp) static std::byte probe[sizeof(Comp)];
+    Comp const* base = reinterpret_cast<Comp const*>(probe);
+    uint32_t const offset = static_cast<uint32_t>(
+      reinterpret_cast<std::byte const*>(&(base->*FIELD)) - reinterpret_cast<std::byte const*>(base));
+    t.columns.push_back(Column{ std::move(name), column_type<Key>(), static_cast<uint32_t>(sizeof(Key)), offset });
+    return *this;
+  }
+
+  template<typename ID_T>
+  bool TColumnExporter<ID_T>::capture(uint64_t stamp)
+  {
+    std::unique_ptr<Snapshot> snap;
+    {
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      if (error_)
+        std::rethrow_exception(error_);
+      if (pending_ >= maxPending_)
+      {
+        ++skipped_;
+        return false;
+      }
+      if (!free_.empty())
+      {
+        snap = std::move(free_.back());
+        free_.pop_back();
+      }
+    }
+    if (!snap)
+      snap = std::make_unique<Snapshot>();
+    if (!started_)
+    {
+      started_ = true;
+      thread_ = std::thread{ [this] { run(); } };
+    }
+
+    snap->stamp = stamp;
+    snap->tables.resize(tables_.size());
+    for (size_t t = 0; t < tables_.size(); ++t)
+      tables_[t].capture(world_, tables_[t], snap->tables[t]);
+
+    {
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      queue_.push_back(std::move(snap));
+      ++pending_;
+    }
+    wake_.notify_one();
+    return true;
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::flush()
+  {
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    done_.wait(lock, [this] { return pending_ == 0; });
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::run()
+  {
+    std::unique_lock<std::mutex> lock{ mutex_ };
+    for (;;)
+    {
+      wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+
+      std::unique_ptr<Snapshot> snap = std::move(queue_.front());
+      queue_.pop_front();
+      bool const last = queue_.empty();
+      lock.unlock();
+
+      // Once a write failed, the rest of the file would be unreadable, so
+      // nothing more is written.
+      std::exception_ptr error;
+      if (!failed_)
+      {
+        try
+        {
+          write(*snap);
+          if (last && std::fflush(file_) != 0)
+            throw std::runtime_error{ "Failed to write export file!" };
+        }
+        catch (...)
+        {
+          error = std::current_exception();
+          failed_ = true;
+          if (file_ != nullptr)
+            std::fclose(file_);
+          file_ = nullptr;
+        }
+      }
+
+      lock.lock();
+      if (error)
+        error_ = error;
+      free_.push_back(std::move(snap));
+      --pending_;
+      done_.notify_all();
+    }
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::write(Snapshot const& snap)
+  {
+    auto padded = [](uint64_t size) { return (size + 7) & ~uint64_t{ 7 }; };
+
+    // Size of the chunk after its size field.
+    uint64_t size = sizeof(uint64_t);
+    for (size_t t = 0; t < tables_.size(); ++t)
+    {
+      uint64_t const rows = snap.tables[t].ids.size();
+      size += sizeof(uint64_t) + padded(rows * sizeof(ID_T));
+      for (Column const& c : tables_[t].columns)
+        size += padded(rows * c.size);
+    }
+
+    if (file_ != nullptr && fileBytes_ + size > fileSize_)
+    {
+      std::fclose(file_);
+      file_ = nullptr;
+    }
+    if (file_ == nullptr)
+      open_file();
+
+    put("CHNK", 4);
+    put_u32(0);
+    put(&size, sizeof(size));
+    put(&snap.stamp, sizeof(snap.stamp));
+    for (size_t t = 0; t < tables_.size(); ++t)
+    {
+      Table const& table = tables_[t];
+      TableSnap const& ts = snap.tables[t];
+      uint64_t const rows = ts.ids.size();
+      put(&rows, sizeof(rows));
+      put(ts.ids.data(), rows * sizeof(ID_T));
+      pad(rows * sizeof(ID_T));
+
+      if (table.whole || !table.copyable)
+      {
+        // Already laid out as columns.
+        std::byte const* data = ts.data.data();
+        for (Column const& c : table.columns)
+        {
+          put(data, rows * c.size);
+          pad(rows * c.size);
+          data += rows * c.size;
+        }
+      }
+      else
+      {
+        // Split the whole components into the listed fields.
+        for (Column const& c : table.columns)
+        {
+          scratch_.resize(rows * c.size);
+          std::byte const* src = ts.data.data() + c.offset;
+          for (size_t i = 0; i < rows; ++i)
+            std::memcpy(scratch_.data() + i * c.size, src + i * table.compSize, c.size);
+          put(scratch_.data(), scratch_.size());
+          pad(scratch_.size());
+        }
+      }
+    }
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::open_file()
+  {
+    char number[16];
+    std::snprintf(number, sizeof(number), "-%06u.cols", static_cast<unsigned>(fileIndex_++));
+    std::string const path = prefix_ + number;
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr)
+      throw std::runtime_error{ "Failed to open export file " + path + "!" };
+    fileBytes_ = 0;
+
+    put("ECSCOLS1", 8);
+    put_u32(static_cast<uint32_t>(sizeof(ID_T)));
+    put_u32(static_cast<uint32_t>(tables_.size()));
+    for (Table const& t : tables_)
+    {
+      put_string(t.name);
+      put_u32(static_cast<uint32_t>(t.columns.size()));
+      for (Column const& c : t.columns)
+      {
+        put_string(c.name);
+        put(&c.type, sizeof(c.type));
+        put_u32(c.size);
+      }
+    }
+    pad(fileBytes_);
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::put(void const* data, size_t size)
+  {
+    if (size > 0 && std::fwrite(data, 1, size, file_) != size)
+      throw std::runtime_error{ "Failed to write export file!" };
+    fileBytes_ += size;
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::put_string(std::string const& s)
+  {
+    put_u32(static_cast<uint32_t>(s.size()));
+    put(s.data(), s.size());
+  }
+
+  template<typename ID_T>
+  void TColumnExporter<ID_T>::pad(size_t size)
+  {
+    static constexpr std::byte zeros[8]{};
+    put(zeros, (8 - size % 8) % 8);
+  }
+} // namespace __detail
+
+// ALIASES ////////////////////////////////////////////////////////////////////
+
+using ColumnExporter = __detail::TColumnExporter<IdT>;
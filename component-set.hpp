@@ -1,67 +1,137 @@
 ///@file    component-set.hpp
 ///@author  Chris Newman
-///@brief   Contains the definition for a simple template for holding a set of 
+///@brief   Contains the definition for a simple template for holding a set of
 ///         references to components belonging to an entity.
 #pragma once
 
+#include <cstddef>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace __detail
 {
   template<typename T>
   using Entry = std::conditional_t<std::is_pointer_v<T>, T, std::add_lvalue_reference_t<T>>;
-}
 
-template<typename ID_T, typename...>
-struct ComponentSet;
+  ///@brief Holds the component at position `I` of a set. The first five are
+  ///       named `a` to `e`, later ones are only reached through `get`.
+  template<size_t I, typename T>
+  struct SetSlot
+  {
+    Entry<T> value;
+    Entry<T> slot() const { return value; }
+  };
+  template<typename T>
+  struct SetSlot<0, T>
+  {
+    Entry<T> a;
+    Entry<T> slot() const { return a; }
+  };
+  template<typename T>
+  struct SetSlot<1, T>
+  {
+    Entry<T> b;
+    Entry<T> slot() const { return b; }
+  };
+  template<typename T>
+  struct SetSlot<2, T>
+  {
+    Entry<T> c;
+    Entry<T> slot() const { return c; }
+  };
+  template<typename T>
+  struct SetSlot<3, T>
+  {
+    Entry<T> d;
+    Entry<T> slot() const { return d; }
+  };
+  template<typename T>
+  struct SetSlot<4, T>
+  {
+    Entry<T> e;
+    Entry<T> slot() const { return e; }
+  };
 
-template<typename ID_T, typename A>
-struct ComponentSet<ID_T, A>
-{
-  static inline const size_t size = 1;
-  ID_T entity;
-  __detail::Entry<A> a;
-};
+  template<typename SEQ, typename ...COMPS>
+  struct SetSlots;
+  template<size_t ...IS, typename ...COMPS>
+  struct SetSlots<std::index_sequence<IS...>, COMPS...> : SetSlot<IS, COMPS>...
+  {
+    explicit SetSlots(Entry<COMPS>... comps)
+      : SetSlot<IS, COMPS>{ comps }... {}
+  };
 
-template<typename ID_T, typename A, typename B>
-struct ComponentSet<ID_T, A, B>
-{
-  static inline const size_t size = 2;
-  ID_T entity;
-  __detail::Entry<A> a;
-  __detail::Entry<B> b;
-};
+  /// Position of the first type in TS whose bare type is that of T.
+  template<typename T, typename ...TS>
+  constexpr size_t set_index_v = []
+  {
+    using Bare = std::remove_const_t<std::remove_pointer_t<T>>;
+    constexpr bool match[] = { std::is_same_v<Bare, std::remove_const_t<std::remove_pointer_t<TS>>>..., false };
+    size_t i = 0;
+    while (i < sizeof...(TS) && !match[i])
+      ++i;
+    return i;
+  }();
+}
 
-template<typename ID_T, typename A, typename B, typename C>
-struct ComponentSet<ID_T, A, B, C>
+///@brief Components of one entity, as references for required types and
+///       pointers for optional (pointer) types, stored directly in the set.
+///       The first five are also named `a` to `e`. The set is tuple-like,
+///       with the entity first, so it supports structured bindings:
+///       `auto [e, pos, vel] = set;` binds the components by reference.
+template<typename ID_T, typename ...COMPS>
+struct ComponentSet
+  : __detail::SetSlots<std::index_sequence_for<COMPS...>, COMPS...>
 {
-  static inline const size_t size = 3;
-  ID_T entity;
-  __detail::Entry<A> a;
-  __detail::Entry<B> b;
-  __detail::Entry<C> c;
-};
+  static constexpr size_t size = sizeof...(COMPS);
 
-template<typename ID_T, typename A, typename B, typename C, typename D>
-struct ComponentSet<ID_T, A, B, C, D>
-{
-  static inline const size_t size = 4;
   ID_T entity;
-  __detail::Entry<A> a;
-  __detail::Entry<B> b;
-  __detail::Entry<C> c;
-  __detail::Entry<D> d;
+
+  ComponentSet(ID_T ent, __detail::Entry<COMPS>... comps)
+    : __detail::SetSlots<std::index_sequence_for<COMPS...>, COMPS...>{ comps... }, entity{ ent } {}
+
+  ///@brief  Gets an element of the tuple-like view of the set.
+  ///@return The entity for `I == 0`, otherwise the component at position
+  ///        `I - 1`.
+  template<size_t I>
+  decltype(auto) get() const
+  {
+    if constexpr (I == 0)
+      return entity;
+    else
+    {
+      using T = std::tuple_element_t<I - 1, std::tuple<COMPS...>>;
+      return static_cast<__detail::SetSlot<I - 1, T> const&>(*this).slot();
+    }
+  }
+
+  ///@brief  Gets the component of type `C`, which may be given with or
+  ///        without its const or pointer qualifiers.
+  template<typename C>
+  decltype(auto) comp() const
+  {
+    constexpr size_t i = __detail::set_index_v<C, COMPS...>;
+    static_assert(i < size, "Type is not part of the set.");
+    return get<i + 1>();
+  }
 };
 
-template<typename ID_T, typename A, typename B, typename C, typename D, typename E>
-struct ComponentSet<ID_T, A, B, C, D, E>
+namespace std
 {
-  static inline const size_t size = 5;
-  ID_T entity;
-  __detail::Entry<A> a;
-  __detail::Entry<B> b;
-  __detail::Entry<C> c;
-  __detail::Entry<D> d;
-  __detail::Entry<E> e;
-};
+  template<typename ID_T, typename ...COMPS>
+  struct tuple_size<ComponentSet<ID_T, COMPS...>>
+    : std::integral_constant<size_t, sizeof...(COMPS) + 1> {};
 
+  template<typename ID_T, typename ...COMPS>
+  struct tuple_element<0, ComponentSet<ID_T, COMPS...>>
+  {
+    using type = ID_T;
+  };
+
+  template<size_t I, typename ID_T, typename ...COMPS>
+  struct tuple_element<I, ComponentSet<ID_T, COMPS...>>
+  {
+    using type = ::__detail::Entry<std::tuple_element_t<I - 1, std::tuple<COMPS...>>>;
+  };
+}
@@ -42,57 +42,43 @@ namespace __detail
 }
 
 template<typename ID_T, typename ...COMPS>
-TComponentView<ID_T, COMPS...>::TComponentView(__detail::TWorld<ID_T>& world)
-  : world_{ world } {}
+TComponentView<ID_T, COMPS...>::TComponentView(__detail::WorldRef world, Arrays arrs, std::shared_ptr<Indices const> ind)
+  : world_{ world }, arrs_{ arrs }, ind_{ std::move(ind) } {}
 
 template <typename ID_T, typename ...COMPS>
 template <typename F>
 void TComponentView<ID_T, COMPS...>::each(F func)
 {
-  for (size_t i = 0; i < ind_[0].size(); ++i)
+  std::apply([&](auto*... arr)
   {
-    size_t j = 0;
-    __detail::OrderedCall{
-      func,
-      (__detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref
-        (world_.
-          compReg_.
-          template get_array<std::remove_const_t<std::remove_pointer_t<COMPS>>>().
-          get_by_index
-          (
-            ind_[j++][i]
-          )
-        )
-      )...
-    };
-  }
+    for (size_t i = 0; i < ind_->count; ++i)
+    {
+      size_t j = 0;
+      __detail::OrderedCall{
+        func,
+        __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_at<COMPS>(arr, ind_->ind[j++][i]))...
+      };
+    }
+  }, arrs_);
 }
 
 template <typename ID_T, typename ...COMPS>
 size_t TComponentView<ID_T, COMPS...>::size() const
 {
-  return ind_[0].size();
+  return ind_->count;
 }
 
 template <typename ID_T, typename ...COMPS>
 ComponentSet<ID_T, COMPS...> TComponentView<ID_T, COMPS...>::operator[](size_t i)
 {
-  size_t j = 0;
-  return
-    ComponentSet<ID_T, COMPS...>{
-      world_.template comp_get_entity<std::tuple_element_t<0, std::tuple<std::remove_const_t<std::remove_pointer_t<COMPS>>...>>>(ind_[0][i]),
-      (__detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref
-        (
-          world_.
-          compReg_.
-          template get_array<std::remove_const_t<std::remove_pointer_t<COMPS>>>().
-          get_by_index
-          (
-            ind_[j++][i]
-          )
-        )
-      )...
+  return std::apply([&](auto*... arr)
+  {
+    size_t j = 0;
+    return ComponentSet<ID_T, COMPS...>{
+      std::get<0>(arrs_)->get_id(ind_->ind[0][i]),
+      __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_at<COMPS>(arr, ind_->ind[j++][i]))...
     };
+  }, arrs_);
 }
 
 template <typename ID_T, typename ...COMPS>
@@ -110,12 +96,43 @@ typename TComponentView<ID_T, COMPS...>::Iterator TComponentView<ID_T, COMPS...>
 template <typename ID_T, typename ...COMPS>
 std::optional<ComponentSet<ID_T, COMPS...>> TComponentView<ID_T, COMPS...>::get_by_entity(ID_T ent)
 {
-  try
-  {
-    return ComponentSet<ID_T, COMPS...>{ ent, __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(world_.template comp_get<std::remove_const_t<std::remove_pointer_t<COMPS>>>(ent))... };
-  }
-  catch (...)
+  // Required components must be present, optional ones may be missing.
+  bool found = true;
+  std::apply([&](auto*... arr)
   {
+    ((found = found && (std::is_pointer_v<COMPS> || arr->contains(ent))), ...);
+  }, arrs_);
+  if (!found)
     return std::nullopt;
-  }
+
+  return std::apply([&](auto*... arr)
+  {
+    return ComponentSet<ID_T, COMPS...>{ ent, __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_of<COMPS>(arr, ent))... };
+  }, arrs_);
+}
+
+template <typename ID_T, typename ...COMPS>
+template <typename T, typename REDUCE, typename TRANSFORM>
+T TComponentView<ID_T, COMPS...>::transform_reduce(T init, REDUCE reduce, TRANSFORM transform) const
+{
+  return transform_reduce_impl(std::make_index_sequence<numberComps>{}, std::move(init), reduce, transform);
+}
+
+template <typename ID_T, typename ...COMPS>
+template <typename T, typename REDUCE>
+T TComponentView<ID_T, COMPS...>::reduce(T init, REDUCE reduce) const
+{
+  static_assert(numberComps == 1, "reduce requires a single component type, use transform_reduce.");
+  return transform_reduce(std::move(init), reduce, [](auto const& c) { return c; });
+}
+
+template <typename ID_T, typename ...COMPS>
+template <size_t... IS, typename T, typename REDUCE, typename TRANSFORM>
+T TComponentView<ID_T, COMPS...>::transform_reduce_impl(std::index_sequence<IS...>, T init, REDUCE& reduce, TRANSFORM& transform) const
+{
+  return __detail::parallel_transform_reduce(size(), std::move(init), reduce, [&](size_t i)
+  {
+    return transform(__detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(
+      __detail::comp_at<ReadT<COMPS>>(std::get<IS>(arrs_), ind_->ind[IS][i]))...);
+  });
 }
@@ -6,13 +6,63 @@
 #pragma once
 
 #include "component-set.hpp"
+#include <memory>
 #include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 
 namespace __detail
 {
   template<typename>
   class TWorld;
+
+  template<typename, typename...>
+  class TStaticWorld;
+
+  ///@brief Dense indices of every matched set, one column per component type.
+  ///       Shared by the views of a join and the world's `ViewCache`.
+  template<size_t N>
+  struct ViewIndices
+  {
+    size_t const*       ind[N];
+    size_t              count = 0;
+    std::vector<size_t> data; ///< Storage of the columns.
+  };
+
+  ///@brief Component type as seen by the join. Constness is dropped, pointer
+  ///       (optional) types are kept apart.
+  template<typename C>
+  using ViewKeyT = std::conditional_t<std::is_pointer_v<C>,
+    std::remove_const_t<std::remove_pointer_t<C>>*, std::remove_const_t<C>>;
+
+  ///@brief Pointer to the world a view was created from, tagged with its type
+  ///       so that it is only ever cast back to that type.
+  class WorldRef
+  {
+  public:
+    template<typename WORLD>
+    WorldRef(WORLD* world)
+      : world_{ world }, tag_{ &tag<WORLD> } {}
+
+    ///@return The world, which must be a `WORLD`.
+    template<typename WORLD>
+    WORLD& get() const
+    {
+      if (tag_ != &tag<WORLD>)
+        throw std::runtime_error{ "View was created from another world type!" };
+      return *static_cast<WORLD*>(world_);
+    }
+
+  private:
+    template<typename WORLD>
+    static constexpr char tag = 0;
+
+    void*       world_;
+    char const* tag_;
+  };
 }
 
 template<typename ID_T, typename ...COMPS>
@@ -67,33 +117,74 @@ public:
   ///@brief   Gets a component set belonging to the given entity.
   std::optional<ComponentSet<ID_T, COMPS...>> get_by_entity(ID_T ent);
 
-  ///@brief Gets the World object that this view was created from.
-  __detail::TWorld<ID_T>& source() const { return world_; }
+  ///@brief           Transforms every set into a `T` and reduces the results,
+  ///                 in parallel for large views. The result is reproducible
+  ///                 bit for bit for a given view, see
+  ///                 `__detail::parallel_transform_reduce`. Double-buffered
+  ///                 types are read from their snapshot.
+  ///@param init      Value the reduction starts from.
+  ///@param reduce    Called as `reduce(T, T)`. Must be thread-safe.
+  ///@param transform Takes the components as const references (pointers
+  ///                 for optional types) and returns a `T`. Must be
+  ///                 thread-safe.
+  template<typename T, typename REDUCE, typename TRANSFORM>
+  T transform_reduce(T init, REDUCE reduce, TRANSFORM transform) const;
+
+  ///@brief        Reduces the components of a single component view, as
+  ///              `transform_reduce`.
+  template<typename T, typename REDUCE>
+  T reduce(T init, REDUCE reduce) const;
+
+  ///@brief Gets the World object that this view was created from. Views of
+  ///       a `TStaticWorld` must name its type as `WORLD`. Throws if `WORLD`
+  ///       is not the type of that world.
+  template<typename WORLD = __detail::TWorld<ID_T>>
+  WORLD& source() const { return world_.template get<WORLD>(); }
 
 private:
+  template<typename, typename...>
+  friend class __detail::TStaticWorld;
+
   static constexpr size_t numberComps = sizeof...(COMPS);
 
-  __detail::TWorld<ID_T>& world_;
-  std::vector<size_t> ind_[numberComps];
+  template<typename C>
+  using Bare = std::remove_const_t<std::remove_pointer_t<C>>;
+  using Arrays = std::tuple<__detail::TCompArray<Bare<COMPS>, ID_T>*...>;
+  using Indices = __detail::ViewIndices<numberComps>;
+  /// Read-only access type of a component type.
+  template<typename C>
+  using ReadT = std::conditional_t<std::is_pointer_v<C>, std::remove_pointer_t<C> const*, C const>;
+
+  template<size_t... IS, typename T, typename REDUCE, typename TRANSFORM>
+  T transform_reduce_impl(std::index_sequence<IS...>, T init, REDUCE& reduce, TRANSFORM& transform) const;
+
+  __detail::WorldRef world_;
+  Arrays             arrs_;
+  // Shared between views of the same join, never modified once built.
+  std::shared_ptr<Indices const> ind_;
 
-  explicit TComponentView(__detail::TWorld<ID_T>& world);
+  TComponentView(__detail::WorldRef world, Arrays arrs, std::shared_ptr<Indices const> ind);
 };
 
 template<typename ID_T>
 class TComponentView<ID_T>
 {
   friend class __detail::TWorld<ID_T>;
+  template<typename, typename...>
+  friend class __detail::TStaticWorld;
 public:
   ///@brief Returns the number of sets contained by the ComponentView
   static size_t size() { return 0; }
 
-  ///@brief Gets the World object that this view was created from.
-  __detail::TWorld<ID_T>& source() const { return world_; }
+  ///@brief Gets the World object that this view was created from, see the
+  ///       non-empty view.
+  template<typename WORLD = __detail::TWorld<ID_T>>
+  WORLD& source() const { return world_.template get<WORLD>(); }
 
 private:
-  __detail::TWorld<ID_T>& world_;
+  __detail::WorldRef world_;
 
-  explicit TComponentView(__detail::TWorld<ID_T>& world)
+  explicit TComponentView(__detail::WorldRef world)
     : world_{ world } {}
 };
 
@@ -0,0 +1,194 @@
+///@file   coroutine.hpp
+///@author Chris Newman
+///@brief  Coroutine tasks that let long running work be spread across ticks.
+///        Requires C++20, compiled out otherwise.
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define ECS_HAS_COROUTINES 1
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <utility>
+
+namespace __detail
+{
+  class CoScheduler;
+}
+
+///@brief Return type of coroutines run by a World. Coroutines start suspended
+///       and are resumed by `TWorld::tick` once passed to `TWorld::co_spawn`.
+class CoTask
+{
+public:
+  struct promise_type
+  {
+    CoTask get_return_object()
+    {
+      return CoTask{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { throw; }
+  };
+
+  CoTask(CoTask&& other) noexcept : handle_{ std::exchange(other.handle_, nullptr) } {}
+  CoTask(CoTask const&) = delete;
+  ~CoTask()
+  {
+    if (handle_)
+      handle_.destroy();
+  }
+
+private:
+  friend class __detail::CoScheduler;
+
+  explicit CoTask(std::coroutine_handle<promise_type> h) : handle_{ h } {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace __detail
+{
+  ///@brief Owns the coroutines of a World and decides when they run. Tasks are
+  ///       resumed once per tick in a slot limited by a time budget, and again
+  ///       at the sync point that ends the tick.
+  class CoScheduler
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Suspends until the next tick's coroutine slot.
+    struct NextTick
+    {
+      CoScheduler& sched_;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) { sched_.ready_.push_back(h); }
+      void await_resume() const noexcept {}
+    };
+
+    /// Suspends until the sync point at the end of the current tick.
+    struct SyncPoint
+    {
+      CoScheduler& sched_;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) { sched_.sync_.push_back(h); }
+      void await_resume() const noexcept {}
+    };
+
+    /// Suspends until the next tick only if this tick's budget is spent.
+    struct BudgetYield
+    {
+      CoScheduler& sched_;
+      bool await_ready() const noexcept { return !sched_.over_budget(); }
+      void await_suspend(std::coroutine_handle<> h) { sched_.ready_.push_back(h); }
+      void await_resume() const noexcept {}
+    };
+
+    CoScheduler() = default;
+    CoScheduler(CoScheduler const&) = delete;
+    ~CoScheduler()
+    {
+      for (auto h : ready_)
+        h.destroy();
+      for (auto h : sync_)
+        h.destroy();
+    }
+
+    ///@brief      Takes ownership of the task. It first runs in the next slot.
+    ///@param task The task to schedule.
+    void spawn(CoTask task)
+    {
+      ready_.push_back(std::exchange(task.handle_, nullptr));
+    }
+
+    ///@brief Sets the time the coroutine slot may take each tick.
+    void set_budget(std::chrono::microseconds budget) { budget_ = budget; }
+
+    ///@return True if the current slot has used up its budget.
+    bool over_budget() const { return Clock::now() - sliceStart_ >= budget_; }
+
+    ///@return Number of coroutines that have not finished yet.
+    size_t count() const { return ready_.size() + sync_.size() + running_; }
+
+    ///@brief Resumes the tasks that were waiting for this tick, in order, until
+    ///       the budget is spent. At least one task is always resumed so every
+    ///       task eventually makes progress. Tasks left over keep their place
+    ///       at the front of the queue.
+    void run_slot()
+    {
+      sliceStart_ = Clock::now();
+      std::deque<std::coroutine_handle<>> batch;
+      batch.swap(ready_);
+
+      bool ranAny = false;
+      try
+      {
+        while (!batch.empty() && !(ranAny && over_budget()))
+        {
+          std::coroutine_handle<> h = batch.front();
+          batch.pop_front();
+          resume(h);
+          ranAny = true;
+        }
+      }
+      catch (...)
+      {
+        ready_.insert(ready_.begin(), batch.begin(), batch.end());
+        throw;
+      }
+      ready_.insert(ready_.begin(), batch.begin(), batch.end());
+    }
+
+    ///@brief Resumes every task waiting on the sync point. Not budgeted.
+    void run_sync()
+    {
+      std::deque<std::coroutine_handle<>> batch;
+      batch.swap(sync_);
+      try
+      {
+        while (!batch.empty())
+        {
+          std::coroutine_handle<> h = batch.front();
+          batch.pop_front();
+          resume(h);
+        }
+      }
+      catch (...)
+      {
+        sync_.insert(sync_.begin(), batch.begin(), batch.end());
+        throw;
+      }
+    }
+
+  private:
+    void resume(std::coroutine_handle<> h)
+    {
+      ++running_;
+      try
+      {
+        h.resume();
+      }
+      catch (...)
+      {
+        --running_;
+        h.destroy();
+        throw;
+      }
+      --running_;
+      if (h.done())
+        h.destroy();
+    }
+
+    std::deque<std::coroutine_handle<>> ready_;
+    std::deque<std::coroutine_handle<>> sync_;
+    std::chrono::microseconds           budget_{ 2000 };
+    Clock::time_point                   sliceStart_{};
+    size_t                              running_ = 0;
+  };
+} // namespace __detail
+
+#endif
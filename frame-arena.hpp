@@ -0,0 +1,197 @@
+///@file   frame-arena.hpp
+///@author Chris Newman
+///@brief  Linear allocator for temporary data that only lives for one tick.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+///@brief Bump allocator owned by a world and reset at the end of every tick.
+///       Allocations are a pointer increment and are never freed one by one,
+///       everything is released at once by `reset`. Memory is kept between
+///       ticks: each reset leaves one block sized for the most the tick just
+///       ended used at once, so a steady workload stops touching the heap
+///       after the first few ticks and a one-off peak is given back at the
+///       next reset. Not thread-safe, only use it from the thread that owns
+///       the world.
+class FrameArena
+{
+public:
+  /// Size of the first block.
+  static constexpr size_t defaultBlockSize = size_t{ 64 } << 10;
+
+  ///@param blockSize Size of the first block, allocated on first use.
+  explicit FrameArena(size_t blockSize = defaultBlockSize)
+    : blockSize_{ blockSize } {}
+
+  FrameArena(FrameArena const&) = delete;
+  FrameArena& operator=(FrameArena const&) = delete;
+
+  ///@brief       Allocates uninitialized memory.
+  ///@param bytes Number of bytes.
+  ///@param align Alignment, a power of two.
+  ///@return      The memory, valid until the next `reset`.
+  void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+  ///@brief       Returns memory to the arena. Only has an effect on the most
+  ///             recent allocation, which lets containers that grow one
+  ///             allocation at a time reuse the space they leave behind.
+  ///@param ptr   Start of the memory.
+  ///@param bytes Number of bytes from `ptr` to the end of the allocation.
+  void release(void* ptr, size_t bytes);
+
+  ///@brief      Creates an object in the arena. Its destructor is never run,
+  ///            so it must be trivially destructible.
+  ///@param args Arguments forwarded to the constructor.
+  template<typename T, typename ...ARGS>
+  T* make(ARGS&&... args);
+
+  ///@brief       Creates a default-initialized array in the arena. Its
+  ///             elements must be trivially destructible.
+  ///@param count Number of elements.
+  template<typename T>
+  T* make_array(size_t count);
+
+  ///@brief Releases every allocation. Invalidates all memory handed out so
+  ///       far. Replaces the blocks with one sized for the most used at once
+  ///       since the last reset, if they are more than one or more than twice
+  ///       that size.
+  void reset();
+
+  ///@return Bytes handed out since the last reset, including padding.
+  size_t used() const { return done_ + top_; }
+  ///@return Bytes currently owned by the arena.
+  size_t capacity() const;
+
+private:
+  struct Block
+  {
+    std::unique_ptr<std::byte[]> data;
+    size_t                       size;
+  };
+
+  std::vector<Block> blocks_;
+  size_t             blockSize_;
+  size_t             cur_ = 0;  ///< Block being allocated from.
+  size_t             top_ = 0;  ///< Offset of the free space in that block.
+  size_t             done_ = 0; ///< Bytes used in the blocks before it.
+  size_t             peak_ = 0; ///< Most bytes used at once since the reset.
+};
+
+///@brief Standard allocator drawing from a `FrameArena`, for containers of
+///       temporary data such as `std::vector<T, TFrameAllocator<T>>`. The
+///       container must not outlive the current tick.
+template<typename T>
+class TFrameAllocator
+{
+public:
+  using value_type = T;
+
+  TFrameAllocator(FrameArena& arena) noexcept
+    : arena_{ &arena } {}
+  template<typename U>
+  TFrameAllocator(TFrameAllocator<U> const& other) noexcept
+    : arena_{ other.arena_ } {}
+
+  T* allocate(size_t count)
+  {
+    return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* ptr, size_t count) noexcept
+  {
+    arena_->release(ptr, count * sizeof(T));
+  }
+
+  template<typename U>
+  bool operator==(TFrameAllocator<U> const& o) const noexcept { return arena_ == o.arena_; }
+  template<typename U>
+  bool operator!=(TFrameAllocator<U> const& o) const noexcept { return arena_ != o.arena_; }
+
+private:
+  template<typename>
+  friend class TFrameAllocator;
+
+  FrameArena* arena_;
+};
+
+// FrameArena /////////////////////////////////////////////////////////////////
+inline void* FrameArena::allocate(size_t bytes, size_t align)
+{
+  for (;;)
+  {
+    if (cur_ == blocks_.size())
+    {
+      // Grow geometrically so a tick needs few blocks.
+      size_t size = blocks_.empty() ? blockSize_ : blocks_.back().size * 2;
+      if (size < bytes + align)
+        size = bytes + align;
+      blocks_.push_back(Block{ std::unique_ptr<std::byte[]>{ new std::byte[size] }, size });
+    }
+
+    Block& block = blocks_[cur_];
+    uintptr_t const base = reinterpret_cast<uintptr_t>(block.data.get());
+    size_t const start = ((base + top_ + align - 1) & ~uintptr_t(align - 1)) - base;
+    if (start + bytes <= block.size)
+    {
+      top_ = start + bytes;
+      peak_ = std::max(peak_, done_ + top_);
+      return block.data.get() + start;
+    }
+
+    // The rest of this block stays unused until the next reset.
+    done_ += top_;
+    top_ = 0;
+    ++cur_;
+  }
+}
+
+inline void FrameArena::release(void* ptr, size_t bytes)
+{
+  if (cur_ == blocks_.size())
+    return;
+  std::byte* const end = static_cast<std::byte*>(ptr) + bytes;
+  if (end == blocks_[cur_].data.get() + top_)
+    top_ -= bytes;
+}
+
+template<typename T, typename ...ARGS>
+T* FrameArena::make(ARGS&&... args)
+{
+  static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed.");
+  return new (allocate(sizeof(T), alignof(T))) T(std::forward<ARGS>(args)...);
+}
+
+template<typename T>
+T* FrameArena::make_array(size_t count)
+{
+  static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed.");
+  T* arr = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+  std::uninitialized_default_construct_n(arr, count);
+  return arr;
+}
+
+inline void FrameArena::reset()
+{
+  // Room for alignment padding, which may fall differently in one block.
+  size_t const size = std::max(blockSize_, peak_ + peak_ / 8);
+  if (blocks_.size() > 1 || (blocks_.size() == 1 && blocks_[0].size / 2 > size))
+  {
+    blocks_.clear();
+    blocks_.push_back(Block{ std::unique_ptr<std::byte[]>{ new std::byte[size] }, size });
+  }
+  cur_ = top_ = done_ = peak_ = 0;
+}
+
+inline size_t FrameArena::capacity() const
+{
+  size_t size = 0;
+  for (Block const& block : blocks_)
+    size += block.size;
+  return size;
+}
@@ -0,0 +1,322 @@
+///@file   index.hpp
+///@author Chris Newman
+///@brief  Secondary indexes that find entities by the value of a component
+///        field.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "array-view.hpp"
+#include "typeid.hpp"
+
+///@brief Kinds of secondary index, see `TWorld::index_add`.
+enum class CompIndex
+{
+  hash,   ///< Equality lookups, used by `index_find` and `index_each`.
+  ordered ///< Lookups of a range of keys, used by `index_range`.
+};
+
+namespace __detail
+{
+  using IndexFamily = struct IndexFamily_;
+
+  ///@brief Splits a pointer to a data member into its class and member type.
+  template<typename T>
+  struct FieldTraits;
+  template<typename C, typename M>
+  struct FieldTraits<M C::*>
+  {
+    using Comp = C;
+    using Key = std::remove_cv_t<M>;
+  };
+
+  /// Component type holding the member `FIELD`.
+  template<auto FIELD>
+  using FieldCompT = typename FieldTraits<decltype(FIELD)>::Comp;
+  /// Type of the member `FIELD`.
+  template<auto FIELD>
+  using FieldKeyT = typename FieldTraits<decltype(FIELD)>::Key;
+
+  // Defined in world.hpp. Indexes only read the components, which must not
+  // count as writes to double-buffered arrays.
+  template<typename COMP, typename ARR, typename ID_T>
+  COMP const* comp_latest(ARR* arr, ID_T id);
+
+  template<typename ID_T>
+  struct ICompIndexBase
+  {
+    virtual ~ICompIndexBase() = default;
+
+    virtual void update(ID_T id) = 0;
+  };
+
+  // THashIndex /////////////////////////////////////////////////////////////////
+  ///@brief Index of the entities in a component array by the value of the
+  ///       member `FIELD`, for equality lookups. Each entity is kept in a list
+  ///       per key, and knows its position in it, so updates are O(1).
+  template<auto FIELD, typename ID_T, typename ARR>
+  class THashIndex final : public ICompIndexBase<ID_T>
+  {
+  public:
+    using Key = FieldKeyT<FIELD>;
+
+    ///@brief     Builds the index from the components currently in `arr`.
+    ///@param arr The array to index. Must outlive the index.
+    explicit THashIndex(ARR& arr);
+    ///@brief    Files the entity under the current value of its field, or
+    ///          drops it if it no longer has the component.
+    ///@param id The entity to update.
+    void update(ID_T id) override;
+    ///@brief     Gets the entities whose field equals the given key.
+    ///@param key The value to look for.
+    ///@return    Array view of the entity ids, in no particular order. Only
+    ///           valid until the index is next updated.
+    TArrayView<ID_T> find(Key const& key);
+  private:
+    struct Entry
+    {
+      Key    key;
+      size_t pos;
+    };
+
+    // Removes the entity from the list of its current key.
+    void unlink(ID_T id, Entry const& entry);
+
+    ARR*                                       arr_;
+    std::unordered_map<Key, std::vector<ID_T>> byKey_;
+    std::unordered_map<ID_T, Entry>            entries_;
+  };
+
+  // TOrderedIndex //////////////////////////////////////////////////////////////
+  ///@brief Index of the entities in a component array by the value of the
+  ///       member `FIELD`, kept in key order for range lookups.
+  template<auto FIELD, typename ID_T, typename ARR>
+  class TOrderedIndex final : public ICompIndexBase<ID_T>
+  {
+  public:
+    using Key = FieldKeyT<FIELD>;
+
+    ///@brief     Builds the index from the components currently in `arr`.
+    ///@param arr The array to index. Must outlive the index.
+    explicit TOrderedIndex(ARR& arr);
+    ///@brief    Files the entity under the current value of its field, or
+    ///          drops it if it no longer has the component.
+    ///@param id The entity to update.
+    void update(ID_T id) override;
+    ///@brief      Calls `func(ID_T)` for every entity whose field lies in
+    ///            `[lo, hi]`, ascending by key and then by id. If the function
+    ///            returns `bool`, iteration stops at the first `false`.
+    ///@param lo   The lowest key to include.
+    ///@param hi   The highest key to include.
+    ///@param func The function to be executed. Must not update the index.
+    template<typename FUNC>
+    void range(Key const& lo, Key const& hi, FUNC func) const;
+  private:
+    ARR*                           arr_;
+    std::set<std::pair<Key, ID_T>> byKey_;
+    std::unordered_map<ID_T, Key>  keys_;
+  };
+
+  // TIndexRegistry /////////////////////////////////////////////////////////////
+  ///@brief Type that owns the secondary indexes of a world and routes updates
+  ///       to the indexes of each component type.
+  template<typename ID_T>
+  class TIndexRegistry
+  {
+  public:
+    ///@brief      Gets the index of type `INDEX`, building it from `arr` if it
+    ///            does not exist yet.
+    ///@param arr  The array the index is built from.
+    ///@param comp Component type id of the array, used to route updates.
+    ///@return     The index.
+    template<typename INDEX, typename ARR>
+    INDEX& get(ARR& arr, uint32_t comp);
+
+    ///@brief      Updates the entity in every index of the given component
+    ///            type.
+    ///@param comp The component type id.
+    ///@param id   The entity to update.
+    void update(uint32_t comp, ID_T id);
+
+    ///@brief    Updates the entity in every index.
+    ///@param id The entity to update.
+    void update_all(ID_T id);
+
+    ///@brief      Calls `func(uint32_t)` with the id of every component type
+    ///            that has at least one index.
+    template<typename FUNC>
+    void each_comp(FUNC func) const;
+
+    ///@return True if there are no indexes.
+    bool empty() const { return indexes_.empty(); }
+  private:
+    std::vector<std::unique_ptr<ICompIndexBase<ID_T>>> indexes_;
+    std::vector<std::vector<ICompIndexBase<ID_T>*>>    byComp_;
+  };
+
+  // THashIndex /////////////////////////////////////////////////////////////////
+  template<auto FIELD, typename ID_T, typename ARR>
+  THashIndex<FIELD, ID_T, ARR>::THashIndex(ARR& arr)
+    : arr_{ &arr }
+  {
+    entries_.reserve(arr.size());
+    for (ID_T id : arr.ids())
+      update(id);
+  }
+
+  template<auto FIELD, typename ID_T, typename ARR>
+  void THashIndex<FIELD, ID_T, ARR>::update(ID_T id)
+  {
+    auto const* comp = comp_latest<FieldCompT<FIELD>>(arr_, id);
+    auto it = entries_.find(id);
+    if (it != entries_.end())
+    {
+      if (comp && it->second.key == comp->*FIELD)
+        return;
+      unlink(id, it->second);
+      if (!comp)
+      {
+        entries_.erase(it);
+        return;
+      }
+      std::vector<ID_T>& ids = byKey_[comp->*FIELD];
+      it->second = Entry{ comp->*FIELD, ids.size() };
+      ids.push_back(id);
+    }
+    else if (comp)
+    {
+      std::vector<ID_T>& ids = byKey_[comp->*FIELD];
+      entries_.emplace(id, Entry{ comp->*FIELD, ids.size() });
+      ids.push_back(id);
+    }
+  }
+
+  template<auto FIELD, typename ID_T, typename ARR>
+  void THashIndex<FIELD, ID_T, ARR>::unlink(ID_T id, Entry const& entry)
+  {
+    auto bucket = byKey_.find(entry.key);
+    std::vector<ID_T>& ids = bucket->second;
+    ID_T const moved = ids.back();
+    ids[entry.pos] = moved;
+    ids.pop_back();
+    if (moved != id)
+      entries_.find(moved)->second.pos = entry.pos;
+    if (ids.empty())
+      byKey_.erase(bucket);
+  }
+
+  template<auto FIELD, typename ID_T, typename ARR>
+  TArrayView<ID_T> THashIndex<FIELD, ID_T, ARR>::find(Key const& key)
+  {
+    auto bucket = byKey_.find(key);
+    if (bucket == byKey_.end())
+      return TArrayView<ID_T>{ nullptr, 0 };
+    return TArrayView<ID_T>{ bucket->second.data(), bucket->second.size() };
+  }
+
+  // TOrderedIndex //////////////////////////////////////////////////////////////
+  template<auto FIELD, typename ID_T, typename ARR>
+  TOrderedIndex<FIELD, ID_T, ARR>::TOrderedIndex(ARR& arr)
+    : arr_{ &arr }
+  {
+    keys_.reserve(arr.size());
+    for (ID_T id : arr.ids())
+      update(id);
+  }
+
+  template<auto FIELD, typename ID_T, typename ARR>
+  void TOrderedIndex<FIELD, ID_T, ARR>::update(ID_T id)
+  {
+    auto const* comp = comp_latest<FieldCompT<FIELD>>(arr_, id);
+    auto it = keys_.find(id);
+    if (it != keys_.end())
+    {
+      if (comp && it->second == comp->*FIELD)
+        return;
+      byKey_.erase({ it->second, id });
+      if (!comp)
+      {
+        keys_.erase(it);
+        return;
+      }
+      it->second = comp->*FIELD;
+    }
+    else if (comp)
+      keys_.emplace(id, comp->*FIELD);
+    else
+      return;
+    byKey_.emplace(comp->*FIELD, id);
+  }
+
+  template<auto FIELD, typename ID_T, typename ARR>
+  template<typename FUNC>
+  void TOrderedIndex<FIELD, ID_T, ARR>::range(Key const& lo, Key const& hi, FUNC func) const
+  {
+    // Ids are unsigned, so pairing `lo` with 0 finds the first entry of `lo`.
+    for (auto it = byKey_.lower_bound({ lo, ID_T{ 0 } }); it != byKey_.end() && !(hi < it->first); ++it)
+    {
+      if constexpr (std::is_same_v<std::invoke_result_t<FUNC, ID_T>, bool>)
+      {
+        if (!func(it->second))
+          return;
+      }
+      else
+        func(it->second);
+    }
+  }
+
+  // TIndexRegistry /////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  template<typename INDEX, typename ARR>
+  INDEX& TIndexRegistry<ID_T>::get(ARR& arr, uint32_t comp)
+  {
+    size_t const key = get_type_id<INDEX, IndexFamily>();
+    if (indexes_.size() <= key)
+      indexes_.resize(key + 1);
+
+    if (!indexes_[key])
+    {
+      indexes_[key] = std::make_unique<INDEX>(arr);
+      if (byComp_.size() <= comp)
+        byComp_.resize(comp + 1);
+      byComp_[comp].push_back(indexes_[key].get());
+    }
+    return static_cast<INDEX&>(*indexes_[key]);
+  }
+
+  template<typename ID_T>
+  void TIndexRegistry<ID_T>::update(uint32_t comp, ID_T id)
+  {
+    if (comp >= byComp_.size())
+      return;
+    for (ICompIndexBase<ID_T>* index : byComp_[comp])
+      index->update(id);
+  }
+
+  template<typename ID_T>
+  void TIndexRegistry<ID_T>::update_all(ID_T id)
+  {
+    for (auto& index : indexes_)
+    {
+      if (index)
+        index->update(id);
+    }
+  }
+
+  template<typename ID_T>
+  template<typename FUNC>
+  void TIndexRegistry<ID_T>::each_comp(FUNC func) const
+  {
+    for (size_t comp = 0; comp < byComp_.size(); ++comp)
+    {
+      if (!byComp_[comp].empty())
+        func(static_cast<uint32_t>(comp));
+    }
+  }
+} // namespace __detail
@@ -0,0 +1,144 @@
+///@file   intersect.hpp
+///@author Chris Newman
+///@brief  Intersection of sorted id lists, vectorized where available.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ECS_INTERSECT_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ECS_INTERSECT_SSE2 1
+#endif
+
+namespace __detail
+{
+  ///@brief  Scalar merge of two ascending lists. Writes the positions of every
+  ///        common value to `outA` and `outB`, starting at `n`.
+  ///@return The number of positions written, including the first `n`.
+  template<typename T>
+  size_t intersect_sorted_scalar(T const* a, size_t na, T const* b, size_t nb,
+    size_t i, size_t j, size_t* outA, size_t* outB, size_t n)
+  {
+    while (i < na && j < nb)
+    {
+      if (a[i] < b[j])
+        ++i;
+      else if (b[j] < a[i])
+        ++j;
+      else
+      {
+        outA[n] = i++;
+        outB[n++] = j++;
+      }
+    }
+    return n;
+  }
+
+  ///@brief Block-wise intersection of ascending 32 bit lists. Each block of `a`
+  ///       is compared against every rotation of the current block of `b`, so a
+  ///       whole block pair is resolved without branching on individual values.
+  inline size_t intersect_sorted_u32(uint32_t const* a, size_t na, uint32_t const* b, size_t nb,
+    size_t* outA, size_t* outB)
+  {
+    size_t i = 0;
+    size_t j = 0;
+    size_t n = 0;
+
+#if defined(ECS_INTERSECT_AVX2)
+    __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i const wrap = _mm256_set1_epi32(7);
+    while (i + 8 <= na && j + 8 <= nb)
+    {
+      __m256i const va = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+      __m256i const vb = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + j));
+
+      int any = 0;
+      uint32_t matchB[8];
+      for (int r = 0; r < 8; ++r)
+      {
+        __m256i const rot = _mm256_and_si256(_mm256_add_epi32(lanes, _mm256_set1_epi32(r)), wrap);
+        __m256i const eq = _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb, rot));
+        int const m = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        for (int l = 0; l < 8; ++l)
+        {
+          if (m & (1 << l))
+            matchB[l] = (l + r) & 7;
+        }
+        any |= m;
+      }
+
+      for (int l = 0; l < 8; ++l)
+      {
+        if (any & (1 << l))
+        {
+          outA[n] = i + l;
+          outB[n++] = j + matchB[l];
+        }
+      }
+
+      uint32_t const lastA = a[i + 7];
+      uint32_t const lastB = b[j + 7];
+      if (lastA <= lastB)
+        i += 8;
+      if (lastB <= lastA)
+        j += 8;
+    }
+#elif defined(ECS_INTERSECT_SSE2)
+    while (i + 4 <= na && j + 4 <= nb)
+    {
+      __m128i const va = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i));
+      __m128i const vb = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + j));
+
+      // Rotation r puts b[(l + r) % 4] in lane l.
+      int const m0 = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+      int const m1 = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))));
+      int const m2 = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)))));
+      int const m3 = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+
+      int const any = m0 | m1 | m2 | m3;
+      for (int l = 0; l < 4; ++l)
+      {
+        if (any & (1 << l))
+        {
+          int const r = (m0 >> l & 1) ? 0 : (m1 >> l & 1) ? 1 : (m2 >> l & 1) ? 2 : 3;
+          outA[n] = i + l;
+          outB[n++] = j + ((l + r) & 3);
+        }
+      }
+
+      uint32_t const lastA = a[i + 3];
+      uint32_t const lastB = b[j + 3];
+      if (lastA <= lastB)
+        i += 4;
+      if (lastB <= lastA)
+        j += 4;
+    }
+#endif
+
+    return intersect_sorted_scalar(a, na, b, nb, i, j, outA, outB, n);
+  }
+
+  ///@brief      Intersects two ascending lists of unique ids.
+  ///@param a    First list.
+  ///@param na   Length of the first list.
+  ///@param b    Second list.
+  ///@param nb   Length of the second list.
+  ///@param outA Receives the position in `a` of every common id, ascending.
+  ///            Needs room for `min(na, nb)` positions.
+  ///@param outB Receives the matching position in `b`, with the same room.
+  ///@return     The number of common ids.
+  template<typename ID_T>
+  size_t intersect_sorted(ID_T const* a, size_t na, ID_T const* b, size_t nb,
+    size_t* outA, size_t* outB)
+  {
+    if constexpr (std::is_same_v<ID_T, uint32_t>)
+      return intersect_sorted_u32(a, na, b, nb, outA, outB);
+    else
+      return intersect_sorted_scalar(a, na, b, nb, 0, 0, outA, outB, 0);
+  }
+} // namespace __detail
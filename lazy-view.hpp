@@ -0,0 +1,253 @@
+///@file   lazy-view.hpp
+///@author Chris Newman
+///@brief  View over components belonging to the same entities that performs
+///        its join while being iterated, without allocating.
+
+#pragma once
+
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+#include "component-set.hpp"
+#include "component-view.hpp"
+
+namespace __detail
+{
+  template<typename>
+  class TWorld;
+
+  template<typename, typename...>
+  class TStaticWorld;
+}
+
+///@brief Lazily joined view of the components of the given types. Unlike
+///       `TComponentView`, no matches are gathered up front: iterators look
+///       up the next match as they advance, so stopping early skips the rest
+///       of the join. Pointer component types are optional, as in
+///       `TComponentView`. Components must not be added or removed while the
+///       view is being iterated.
+template<typename ID_T, typename ...COMPS>
+class TLazyView
+{
+  static_assert(sizeof...(COMPS) > 0, "One or more component names required");
+
+  friend class __detail::TWorld<ID_T>;
+  template<typename, typename...>
+  friend class __detail::TStaticWorld;
+
+  template<typename C>
+  using Bare = std::remove_const_t<std::remove_pointer_t<C>>;
+  using Arrays = std::tuple<__detail::TCompArray<Bare<COMPS>, ID_T>*...>;
+
+  static constexpr size_t numberComps = sizeof...(COMPS);
+
+public:
+  /// Set of components yielded for each matching entity.
+  using Set = ComponentSet<ID_T, COMPS...>;
+
+  /// Iterator yielding a `Set` for every matching entity. Sets are made on
+  /// dereference, so it is only an input iterator to pre-C++20 algorithms.
+  /// Holds the arrays itself and stays valid after the view is gone.
+  class Iterator
+  {
+  public:
+    ///@brief Holds the `Set` that `operator->` points to.
+    struct Arrow
+    {
+      Set set;
+      Set const* operator->() const { return &set; }
+    };
+
+    using iterator_category = std::input_iterator_tag;
+    using iterator_concept = std::forward_iterator_tag;
+    using value_type = Set;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Arrow;
+    using reference = Set;
+
+    Iterator() = default;
+
+    Set operator*() const { return make_set(std::make_index_sequence<numberComps>{}); }
+    Arrow operator->() const { return Arrow{ **this }; }
+
+    Iterator& operator++() { ++pos_; seek(); return *this; }
+    Iterator operator++(int) { Iterator i = *this; ++(*this); return i; }
+
+    bool operator==(Iterator const& o) const { return pos_ == o.pos_; }
+    bool operator!=(Iterator const& o) const { return pos_ != o.pos_; }
+
+    ///@brief Gets the entity the iterator currently refers to.
+    ID_T entity() const { return std::get<0>(arrs_)->get_id(pos_); }
+
+  private:
+    friend class TLazyView;
+
+    Arrays arrs_{};
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    size_t ind_[numberComps]{};
+
+    Iterator(Arrays const& arrs, size_t pos, size_t end)
+      : arrs_{ arrs }, pos_{ pos }, end_{ end } {}
+
+    // Moves forward until the entity at pos_ has every required component.
+    void seek();
+
+    template<size_t... IS>
+    bool probe(std::index_sequence<IS...>);
+
+    template<size_t... IS>
+    Set make_set(std::index_sequence<IS...>) const;
+  };
+
+  Iterator begin() const;
+  Iterator end() const;
+
+  ///@brief      Executes a given function for each matching set of components.
+  ///            If the function returns `bool`, iteration stops at the first
+  ///            `false`.
+  ///@param func The function to be executed. Takes the components the same
+  ///            way as `TComponentView::each`.
+  template<typename F>
+  void each(F func) const;
+
+  ///@brief      Finds the first set satisfying the given predicate. The join
+  ///            stops as soon as it is found.
+  ///@param pred Predicate taking a `Set`.
+  ///@return     The first matching set, or `std::nullopt` if there is none.
+  template<typename PRED>
+  std::optional<Set> find_if(PRED pred) const;
+
+  ///@brief  Gets the first matching set.
+  ///@return The first set, or `std::nullopt` if the view is empty.
+  std::optional<Set> first() const;
+
+  ///@brief  Checks if there is at least one matching set.
+  bool empty() const { return begin() == end(); }
+
+  ///@brief  Counts the matching sets. Walks the whole join.
+  size_t count() const;
+
+  ///@brief Gets the World object that this view was created from, see
+  ///       `TComponentView::source`.
+  template<typename WORLD = __detail::TWorld<ID_T>>
+  WORLD& source() const { return world_.template get<WORLD>(); }
+
+private:
+  __detail::WorldRef world_;
+  Arrays             arrs_;
+
+  TLazyView(__detail::WorldRef world, Arrays arrs)
+    : world_{ world }, arrs_{ arrs } {}
+};
+
+// TLazyView::Iterator ////////////////////////////////////////////////////////
+template<typename ID_T, typename ...COMPS>
+void TLazyView<ID_T, COMPS...>::Iterator::seek()
+{
+  while (pos_ < end_ && !probe(std::make_index_sequence<numberComps>{}))
+    ++pos_;
+}
+
+template<typename ID_T, typename ...COMPS>
+template<size_t... IS>
+bool TLazyView<ID_T, COMPS...>::Iterator::probe(std::index_sequence<IS...>)
+{
+  ID_T const ent = std::get<0>(arrs_)->get_id(pos_);
+  bool match = true;
+  // Short-circuits at the first missing required component.
+  ((match = match && (
+    (ind_[IS] = IS == 0 ? pos_ : std::get<IS>(arrs_)->index_of(ent)) != std::numeric_limits<size_t>::max()
+    || std::is_pointer_v<std::tuple_element_t<IS, std::tuple<COMPS...>>>)), ...);
+  return match;
+}
+
+template<typename ID_T, typename ...COMPS>
+template<size_t... IS>
+typename TLazyView<ID_T, COMPS...>::Set
+TLazyView<ID_T, COMPS...>::Iterator::make_set(std::index_sequence<IS...>) const
+{
+  return Set{
+    std::get<0>(arrs_)->get_id(pos_),
+    __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_at<COMPS>(std::get<IS>(arrs_), ind_[IS]))...
+  };
+}
+
+// TLazyView //////////////////////////////////////////////////////////////////
+template<typename ID_T, typename ...COMPS>
+typename TLazyView<ID_T, COMPS...>::Iterator TLazyView<ID_T, COMPS...>::begin() const
+{
+  Iterator it{ arrs_, 0, std::get<0>(arrs_)->size() };
+  it.seek();
+  return it;
+}
+
+template<typename ID_T, typename ...COMPS>
+typename TLazyView<ID_T, COMPS...>::Iterator TLazyView<ID_T, COMPS...>::end() const
+{
+  size_t const size = std::get<0>(arrs_)->size();
+  return Iterator{ arrs_, size, size };
+}
+
+template<typename ID_T, typename ...COMPS>
+template<typename F>
+void TLazyView<ID_T, COMPS...>::each(F func) const
+{
+  for (Iterator it = begin(), e = end(); it != e; ++it)
+  {
+    bool keepGoing = std::apply([&](auto*... arr)
+    {
+      size_t j = 0;
+      using R = std::invoke_result_t<F, decltype(__detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_at<COMPS>(arr, 0)))...>;
+      if constexpr (std::is_same_v<R, bool>)
+      {
+        bool ret = true;
+        __detail::OrderedCall{ [&](auto&&... comps) { ret = func(comps...); },
+          __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_at<COMPS>(arr, it.ind_[j++]))... };
+        return ret;
+      }
+      else
+      {
+        __detail::OrderedCall{ func,
+          __detail::MaybeDeref<std::is_pointer_v<COMPS>>::deref(__detail::comp_at<COMPS>(arr, it.ind_[j++]))... };
+        return true;
+      }
+    }, arrs_);
+
+    if (!keepGoing)
+      return;
+  }
+}
+
+template<typename ID_T, typename ...COMPS>
+template<typename PRED>
+std::optional<typename TLazyView<ID_T, COMPS...>::Set> TLazyView<ID_T, COMPS...>::find_if(PRED pred) const
+{
+  for (Iterator it = begin(), e = end(); it != e; ++it)
+  {
+    if (pred(*it))
+      return *it;
+  }
+  return std::nullopt;
+}
+
+template<typename ID_T, typename ...COMPS>
+std::optional<typename TLazyView<ID_T, COMPS...>::Set> TLazyView<ID_T, COMPS...>::first() const
+{
+  Iterator it = begin();
+  if (it == end())
+    return std::nullopt;
+  return *it;
+}
+
+template<typename ID_T, typename ...COMPS>
+size_t TLazyView<ID_T, COMPS...>::count() const
+{
+  size_t n = 0;
+  for (Iterator it = begin(), e = end(); it != e; ++it)
+    ++n;
+  return n;
+}
@@ -0,0 +1,117 @@
+///@file   reduce.hpp
+///@author Chris Newman
+///@brief  Chunked, deterministic parallel reduction used by the world and
+///        view `reduce` functions.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "worker-pool.hpp"
+
+namespace __detail
+{
+  /// Elements reduced serially as one unit. Fixed so that the shape of the
+  /// reduction tree only depends on the element count.
+  constexpr size_t reduceChunk = 4096;
+  /// Independent accumulators per chunk, letting the inner loop vectorize.
+  constexpr size_t reduceLanes = 8;
+  /// Chunks below which a reduction is not worth spreading over threads.
+  constexpr size_t reduceMinChunksPerThread = 4;
+
+  template<typename T, typename TRANSFORM, size_t... IS>
+  std::array<T, reduceLanes> reduce_lanes_init(TRANSFORM& transform, size_t begin, std::index_sequence<IS...>)
+  {
+    return { transform(begin + IS)... };
+  }
+
+  ///@brief Reduces the elements `[begin, end)` of a chunk. Element `i` goes to
+  ///       lane `i % reduceLanes` and the lanes are combined pairwise.
+  template<typename T, typename REDUCE, typename TRANSFORM>
+  T reduce_chunk(size_t begin, size_t end, REDUCE& reduce, TRANSFORM& transform)
+  {
+    if (end - begin < reduceLanes)
+    {
+      T acc = transform(begin);
+      for (size_t i = begin + 1; i < end; ++i)
+        acc = reduce(std::move(acc), transform(i));
+      return acc;
+    }
+
+    std::array<T, reduceLanes> acc =
+      reduce_lanes_init<T>(transform, begin, std::make_index_sequence<reduceLanes>{});
+    size_t i = begin + reduceLanes;
+    for (; i + reduceLanes <= end; i += reduceLanes)
+    {
+      for (size_t k = 0; k < reduceLanes; ++k)
+        acc[k] = reduce(std::move(acc[k]), transform(i + k));
+    }
+    for (size_t k = 0; i < end; ++i, ++k)
+      acc[k] = reduce(std::move(acc[k]), transform(i));
+
+    for (size_t w = reduceLanes / 2; w > 0; w /= 2)
+    {
+      for (size_t k = 0; k < w; ++k)
+        acc[k] = reduce(std::move(acc[k]), std::move(acc[k + w]));
+    }
+    return std::move(acc[0]);
+  }
+
+  ///@brief           Reduces `transform(0) ... transform(count - 1)` and
+  ///                 combines the result with `init`. Elements are reduced in
+  ///                 fixed chunks which are spread over worker threads and
+  ///                 combined pairwise, so for a given element count the
+  ///                 order in which `reduce` is applied never changes and
+  ///                 floating point results are reproducible, independent of
+  ///                 the number of threads. `reduce` must be associative and
+  ///                 commutative up to rounding, as for `std::reduce`.
+  ///@param count     Number of elements.
+  ///@param init      Value combined with the reduction of all elements.
+  ///@param reduce    Called as `reduce(T, T)`. Must be safe to call from
+  ///                 several threads at once.
+  ///@param transform Called as `transform(size_t index)`, returning `T`. Must
+  ///                 be safe to call from several threads at once.
+  ///@param threads   Maximum number of threads to use. 0 uses one per
+  ///                 hardware thread.
+  template<typename T, typename REDUCE, typename TRANSFORM>
+  T parallel_transform_reduce(size_t count, T init, REDUCE reduce, TRANSFORM transform, size_t threads = 0)
+  {
+    if (count == 0)
+      return init;
+
+    size_t const chunks = (count + reduceChunk - 1) / reduceChunk;
+    std::vector<std::optional<T>> partial(chunks);
+
+    auto run = [&](size_t first, size_t last)
+    {
+      for (size_t c = first; c < last; ++c)
+        partial[c].emplace(reduce_chunk<T>(c * reduceChunk, std::min(count, (c + 1) * reduceChunk), reduce, transform));
+    };
+
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<size_t>(1, chunks / reduceMinChunksPerThread));
+    if (threads == 1)
+      run(0, chunks);
+    else
+    {
+      // Chunks are handed out one at a time, so threads that get to the
+      // work late still share it. Each chunk has its own slot, so the
+      // result does not depend on which thread reduced it.
+      auto chunk = [&](size_t c) { run(c, c + 1); };
+      WorkerPool::shared().parallel_for(chunks, threads, chunk);
+    }
+
+    for (size_t w = 1; w < chunks; w *= 2)
+    {
+      for (size_t c = 0; c + w < chunks; c += 2 * w)
+        partial[c].emplace(reduce(std::move(*partial[c]), std::move(*partial[c + w])));
+    }
+    return reduce(std::move(init), std::move(*partial[0]));
+  }
+} // namespace __detail
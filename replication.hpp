@@ -0,0 +1,967 @@
+///@file   replication.hpp
+///@author Chris Newman
+///@brief  Delta-compressed replication of component state to remote worlds.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "world.hpp"
+
+///@brief Quantization of a floating point field. Values are clamped to
+///       `[min, max]` and sent as one of `2^bits` evenly spaced steps, so
+///       changes smaller than a step are not sent at all.
+struct ReplQuant
+{
+  double  min;
+  double  max;
+  uint8_t bits; ///< 1 to 32.
+};
+
+///@brief In-memory transport that delivers packets in order, for running a
+///       replicator and its receivers in one process. Stands in for the
+///       reliable, ordered channel the replication stream expects.
+class ReplLoopback
+{
+public:
+  ///@brief        Queues a copy of a packet.
+  ///@param packet The packet to send.
+  void send(std::vector<uint8_t> const& packet);
+
+  ///@brief        Takes the oldest queued packet.
+  ///@param packet Receives the packet.
+  ///@return       False if no packet was queued.
+  bool receive(std::vector<uint8_t>& packet);
+
+  ///@return Number of packets queued.
+  size_t pending() const { return queue_.size(); }
+  ///@return Total size of the packets sent so far, in bytes.
+  size_t bytes_sent() const { return bytesSent_; }
+
+private:
+  std::deque<std::vector<uint8_t>> queue_;
+  size_t                           bytesSent_ = 0;
+};
+
+namespace __detail
+{
+  // ReplBitWriter //////////////////////////////////////////////////////////////
+  ///@brief Appends values of arbitrary bit width to a byte buffer, least
+  ///       significant bit first.
+  class ReplBitWriter
+  {
+  public:
+    explicit ReplBitWriter(std::vector<uint8_t>& out)
+      : out_{ out } {}
+
+    ///@brief       Writes the low `bits` bits of a value.
+    ///@param bits  0 to 64.
+    void write(uint64_t value, unsigned bits);
+
+    ///@brief Writes a value with an Exp-Golomb code, which takes 2n + 1 bits
+    ///       for a value below 2^n. Small values are cheap. The value must be
+    ///       below 2^64 - 1.
+    void write_var(uint64_t value);
+
+    ///@brief Writes the bits that do not fill a whole byte yet.
+    void flush();
+
+  private:
+    std::vector<uint8_t>& out_;
+    uint64_t              acc_ = 0;
+    unsigned              count_ = 0; ///< Bits held in acc_, always below 8.
+  };
+
+  // ReplBitReader //////////////////////////////////////////////////////////////
+  ///@brief Reads the values written by `ReplBitWriter`.
+  class ReplBitReader
+  {
+  public:
+    ReplBitReader(uint8_t const* data, size_t size)
+      : data_{ data }, size_{ size } {}
+
+    ///@brief      Reads a value of `bits` bits. Throws if the data ends first.
+    ///@param bits 0 to 64.
+    uint64_t read(unsigned bits);
+    ///@brief Reads a value written by `ReplBitWriter::write_var`.
+    uint64_t read_var();
+
+  private:
+    uint8_t const* data_;
+    size_t         size_;
+    size_t         pos_ = 0;
+    uint64_t       acc_ = 0;
+    unsigned       count_ = 0;
+  };
+
+  // TReplSchema ////////////////////////////////////////////////////////////////
+  ///@brief A replicated field, converted to and from an integer of `bits`
+  ///       bits.
+  struct ReplField
+  {
+    uint8_t   bits;
+    uint32_t  offset; ///< Byte offset of a raw word, unused by members.
+    ReplQuant quant;
+    uint64_t (*get)(void const* comp, ReplField const& field);
+    void (*set)(void* comp, uint64_t value, ReplField const& field);
+  };
+
+  /// Fields per component type, so that a change mask fits in 64 bits.
+  constexpr size_t replMaxFields = 64;
+
+  template<typename ID_T>
+  struct ReplState;
+
+  ///@brief A replicated component type and how to reach it in a world.
+  template<typename ID_T>
+  struct ReplType
+  {
+    uint32_t               key;
+    bool                   raw;    ///< Sent as whole 32-bit words.
+    std::vector<ReplField> fields;
+
+    void (*gather)(TWorld<ID_T>& world, ReplType const& type, ReplState<ID_T>& state, std::vector<size_t>& order);
+    void* (*add)(TWorld<ID_T>& world, ID_T e);
+    void* (*get)(TWorld<ID_T>& world, ID_T e);
+    void (*remove)(TWorld<ID_T>& world, ID_T e);
+    void (*changed)(TWorld<ID_T>& world, ID_T e);
+  };
+
+  ///@brief Encoded fields of every component of one type, ordered by entity
+  ///       id. Entity `ids[i]` owns `values[i * fields, (i + 1) * fields)`.
+  template<typename ID_T>
+  struct ReplState
+  {
+    std::vector<ID_T>     ids;
+    std::vector<uint64_t> values;
+  };
+
+  ///@brief Component types and fields that are replicated. Types are known on
+  ///       the wire by the order they were added in, so the sending and the
+  ///       receiving side must build the same schema.
+  template<typename ID_T>
+  class TReplSchema
+  {
+  public:
+    ///@brief Replicates the whole component, cut into 32-bit words that are
+    ///       each only sent when they change. The type must be trivially
+    ///       copyable, and padding bytes are compared too, so types with
+    ///       padding or fields that need less precision should list their
+    ///       fields instead. Empty types only replicate their presence.
+    template<typename COMP>
+    TReplSchema& comp();
+
+    ///@brief Replicates the member `FIELD` at full precision, as in
+    ///       `field<&Pos::x>()`. Adds its component type if needed, which
+    ///       then only replicates the fields listed. The field must be an
+    ///       arithmetic or enum type.
+    template<auto FIELD>
+    TReplSchema& field();
+
+    ///@brief      Replicates an integer member in its low `bits` bits. Signed
+    ///            values are zigzag encoded first, so small magnitudes of
+    ///            either sign fit.
+    ///@param bits Number of bits. Values that do not fit are truncated.
+    template<auto FIELD>
+    TReplSchema& field(uint8_t bits);
+
+    ///@brief       Replicates a floating point member quantized to the given
+    ///             range and precision.
+    ///@param quant The quantization.
+    template<auto FIELD>
+    TReplSchema& field(ReplQuant quant);
+
+    ///@return The replicated types, in wire order.
+    std::vector<ReplType<ID_T>> const& types() const { return types_; }
+
+  private:
+    template<typename COMP>
+    ReplType<ID_T>& type();
+
+    template<auto FIELD>
+    TReplSchema& add_field(uint8_t bits, ReplQuant quant);
+
+    template<typename T>
+    static uint64_t encode(T value, ReplField const& field);
+    template<typename T>
+    static T decode(uint64_t value, ReplField const& field);
+
+    std::vector<ReplType<ID_T>> types_;
+  };
+
+  // TReplicator ////////////////////////////////////////////////////////////////
+  ///@brief Sending side of replication. `update` encodes the replicated
+  ///       components of a world once, then `encode` writes, for each peer,
+  ///       only the components added, removed or changed since the state that
+  ///       peer was last sent, down to the individual field. Peers sent every
+  ///       update share one baseline, the previous update, and one packet, so
+  ///       the cost per peer is a copy. Peers that miss updates keep a
+  ///       baseline of their own until they catch up. The stream assumes a
+  ///       reliable, ordered transport: the state sent becomes the peer's
+  ///       baseline as soon as it is encoded. Use `peer_reset` to resend
+  ///       everything, for instance after reconnecting.
+  template<typename ID_T>
+  class TReplicator
+  {
+  public:
+    /// Handle of a peer.
+    using Peer = uint32_t;
+
+    ///@param world  The world to replicate. Must outlive the replicator.
+    ///@param schema What to replicate. Copied.
+    TReplicator(TWorld<ID_T>& world, TReplSchema<ID_T> const& schema);
+
+    ///@brief  Adds a peer. Its first packet holds the whole state.
+    ///@return The handle of the peer.
+    Peer peer_add();
+    ///@brief Removes a peer and frees its baseline. The handle may be reused.
+    void peer_remove(Peer peer);
+    ///@brief Drops the baseline of a peer, so its next packet holds the
+    ///       whole state.
+    void peer_reset(Peer peer);
+
+    ///@brief Captures the current state of the world. Call once per tick,
+    ///       before encoding the packets of that tick for each peer.
+    void update();
+
+    ///@brief        Writes the difference between the state captured by the
+    ///              last `update` and the peer's baseline, then makes that
+    ///              state the peer's baseline. For each type of the schema,
+    ///              in order, the packet holds a list of records ended by a 0
+    ///              bit. A record is a 1 bit, the entity id as the gap from
+    ///              the previous record's id plus one, then either a 1 bit, a
+    ///              mask of the changed fields and their values, a 0 and a 1
+    ///              bit and the values of every field for an added
+    ///              component, or two 0 bits for a removed one.
+    ///@param peer   The peer to encode for.
+    ///@param packet Receives the packet. Its capacity is reused.
+    void encode(Peer peer, std::vector<uint8_t>& packet);
+
+  private:
+    struct PeerData
+    {
+      bool                         live = false;
+      uint64_t                     update = 0; ///< Update it was last sent.
+      std::vector<ReplState<ID_T>> base;       ///< Its own baseline, if behind.
+    };
+
+    ///@brief Writes the difference between a baseline and `current_`.
+    void write_diff(std::vector<ReplState<ID_T>> const& base, std::vector<uint8_t>& packet) const;
+
+    TWorld<ID_T>&                world_;
+    TReplSchema<ID_T>            schema_;
+    std::vector<ReplState<ID_T>> current_;
+    std::vector<ReplState<ID_T>> previous_;
+    uint64_t                     update_ = 0;       ///< Updates done so far.
+    std::vector<uint8_t>         shared_;           ///< Packet from previous_.
+    uint64_t                     sharedUpdate_ = 0; ///< Update shared_ is for.
+    std::vector<PeerData>        peers_;
+    std::vector<size_t>          order_;
+  };
+
+  // TReplReceiver //////////////////////////////////////////////////////////////
+  ///@brief Receiving side of replication. Applies the packets of one
+  ///       `TReplicator` peer to a world. Remote entities get local entities
+  ///       of their own, created with their first replicated component and
+  ///       destroyed, with every component they have, when their last one is
+  ///       removed. Components are default constructed before their fields
+  ///       are set.
+  template<typename ID_T>
+  class TReplReceiver
+  {
+  public:
+    using Entity = TEntity<ID_T>;
+
+    ///@param world  The world to apply packets to. Must outlive the receiver.
+    ///@param schema The schema the sender uses. Copied.
+    TReplReceiver(TWorld<ID_T>& world, TReplSchema<ID_T> const& schema);
+
+    ///@brief        Applies a packet. Packets must be applied in the order
+    ///              they were encoded. Throws if the packet is malformed or
+    ///              does not match the local state.
+    ///@param packet The packet.
+    void apply(std::vector<uint8_t> const& packet) { apply(packet.data(), packet.size()); }
+    void apply(uint8_t const* data, size_t size);
+
+    ///@param  remote An entity of the sending world.
+    ///@return The local entity mirroring it, or `Entity::invalid()`.
+    Entity local(ID_T remote) const;
+
+  private:
+    struct Mirror
+    {
+      ID_T     local;
+      uint32_t comps; ///< Replicated components it has.
+    };
+
+    TWorld<ID_T>&                    world_;
+    TReplSchema<ID_T>                schema_;
+    std::unordered_map<ID_T, Mirror> mirrors_;
+  };
+} // namespace __detail
+
+// ReplLoopback ///////////////////////////////////////////////////////////////
+inline void ReplLoopback::send(std::vector<uint8_t> const& packet)
+{
+  queue_.push_back(packet);
+  bytesSent_ += packet.size();
+}
+
+inline bool ReplLoopback::receive(std::vector<uint8_t>& packet)
+{
+  if (queue_.empty())
+    return false;
+  packet.swap(queue_.front());
+  queue_.pop_front();
+  return true;
+}
+
+namespace __detail
+{
+  // ReplBitWriter //////////////////////////////////////////////////////////////
+  inline void ReplBitWriter::write(uint64_t value, unsigned bits)
+  {
+    if (bits > 32)
+    {
+      write(value, 32);
+      write(value >> 32, bits - 32);
+      return;
+    }
+    if (bits < 64)
+      value &= (uint64_t{ 1 } << bits) - 1;
+    acc_ |= value << count_;
+    count_ += bits;
+    while (count_ >= 8)
+    {
+      out_.push_back(static_cast<uint8_t>(acc_));
+      acc_ >>= 8;
+      count_ -= 8;
+    }
+  }
+
+  inline void ReplBitWriter::write_var(uint64_t value)
+  {
+    uint64_t const x = value + 1;
+    unsigned n = 0;
+    while (n < 63 && (x >> (n + 1)) != 0)
+      ++n;
+    // n zeros, a one, then the n bits below the leading one.
+    write(0, n);
+    write(1, 1);
+    write(x, n);
+  }
+
+  inline void ReplBitWriter::flush()
+  {
+    if (count_ > 0)
+      out_.push_back(static_cast<uint8_t>(acc_));
+    acc_ = 0;
+    count_ = 0;
+  }
+
+  // ReplBitReader //////////////////////////////////////////////////////////////
+  inline uint64_t ReplBitReader::read(unsigned bits)
+  {
+    if (bits > 32)
+    {
+      uint64_t const low = read(32);
+      return low | (read(bits - 32) << 32);
+    }
+    while (count_ < bits)
+    {
+      if (pos_ == size_)
+        throw std::runtime_error{ "Replication packet is truncated!" };
+      acc_ |= uint64_t{ data_[pos_++] } << count_;
+      count_ += 8;
+    }
+    uint64_t const value = bits == 0 ? 0 : acc_ & ((uint64_t{ 1 } << bits) - 1);
+    acc_ = bits == 0 ? acc_ : acc_ >> bits;
+    count_ -= bits;
+    return value;
+  }
+
+  inline uint64_t ReplBitReader::read_var()
+  {
+    unsigned n = 0;
+    while (read(1) == 0)
+    {
+      if (++n > 63)
+        throw std::runtime_error{ "Replication packet is malformed!" };
+    }
+    uint64_t const x = (uint64_t{ 1 } << n) | read(n);
+    return x - 1;
+  }
+
+  // TReplSchema ////////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  template<typename COMP>
+  ReplType<ID_T>& TReplSchema<ID_T>::type()
+  {
+    static_assert(std::is_default_constructible_v<COMP>, "Replicated components must be default constructible.");
+
+    uint32_t const key = get_type_id<COMP, ComponentFamily>();
+    for (ReplType<ID_T>& t : types_)
+    {
+      if (t.key == key)
+        return t;
+    }
+
+    ReplType<ID_T> t{};
+    t.key = key;
+    t.gather = [](TWorld<ID_T>& world, ReplType<ID_T> const& type, ReplState<ID_T>& state, std::vector<size_t>& order)
+    {
+      TArrayView<ID_T> ids = world.template comp_get_entities<COMP>();
+      size_t const count = ids.size();
+      size_t const fields = type.fields.size();
+
+      // Arrays kept sorted by comp_keep_sorted skip the sort.
+      order.resize(count);
+      std::iota(order.begin(), order.end(), size_t{ 0 });
+      if (!std::is_sorted(ids.begin(), ids.end()))
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ids[a] < ids[b]; });
+
+      state.ids.resize(count);
+      state.values.resize(count * fields);
+      for (size_t k = 0; k < count; ++k)
+        state.ids[k] = ids[order[k]];
+      if (fields == 0)
+        return;
+
+      auto encode = [&](size_t k, void const* comp)
+      {
+        uint64_t* out = state.values.data() + k * fields;
+        for (size_t f = 0; f < fields; ++f)
+          out[f] = type.fields[f].get(comp, type.fields[f]);
+      };
+      if constexpr (comp_layout_v<COMP> == CompLayout::packed)
+      {
+        COMP const* comps = world.template comp_get<COMP>().data();
+        for (size_t k = 0; k < count; ++k)
+          encode(k, comps + order[k]);
+      }
+      else
+      {
+        // Only read, so double-buffered types are not marked as written.
+        for (size_t k = 0; k < count; ++k)
+          encode(k, world.template comp_latest<COMP>(state.ids[k]));
+      }
+    };
+    t.add = [](TWorld<ID_T>& world, ID_T e) -> void*
+    {
+      world.template comp_add<COMP>(e);
+      return world.template comp_get<COMP>(e);
+    };
+    t.get = [](TWorld<ID_T>& world, ID_T e) -> void*
+    {
+      return world.template comp_get<COMP>(e);
+    };
+    t.remove = [](TWorld<ID_T>& world, ID_T e)
+    {
+      world.template comp_remove<COMP>(e);
+    };
+    t.changed = [](TWorld<ID_T>& world, ID_T e)
+    {
+      world.template comp_changed<COMP>(e);
+    };
+    types_.push_back(std::move(t));
+    return types_.back();
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  TReplSchema<ID_T>& TReplSchema<ID_T>::comp()
+  {
+    static_assert(std::is_empty_v<COMP> || std::is_trivially_copyable_v<COMP>,
+      "Only trivially copyable components can be replicated whole, list their fields instead.");
+    static_assert(sizeof(COMP) <= 4 * replMaxFields, "Component too large to be replicated whole, list its fields instead.");
+
+    bool const isNew = std::none_of(types_.begin(), types_.end(),
+      [](ReplType<ID_T> const& t) { return t.key == get_type_id<COMP, ComponentFamily>(); });
+    ReplType<ID_T>& t = type<COMP>();
+    if (!isNew || std::is_empty_v<COMP>)
+      return *this;
+
+    t.raw = true;
+    for (uint32_t offset = 0; offset < sizeof(COMP); offset += 4)
+    {
+      ReplField f{};
+      f.bits = static_cast<uint8_t>(8 * std::min<size_t>(4, sizeof(COMP) - offset));
+      f.offset = offset;
+      f.get = [](void const* comp, ReplField const& field) -> uint64_t
+      {
+        uint32_t word = 0;
+        std::memcpy(&word, static_cast<uint8_t const*>(comp) + field.offset, field.bits / 8);
+        return word;
+      };
+      f.set = [](void* comp, uint64_t value, ReplField const& field)
+      {
+        uint32_t const word = static_cast<uint32_t>(value);
+        std::memcpy(static_cast<uint8_t*>(comp) + field.offset, &word, field.bits / 8);
+      };
+      t.fields.push_back(f);
+    }
+    return *this;
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  TReplSchema<ID_T>& TReplSchema<ID_T>::field()
+  {
+    using Key = FieldKeyT<FIELD>;
+    if constexpr (std::is_same_v<Key, bool>)
+      return add_field<FIELD>(1, ReplQuant{});
+    else
+      return add_field<FIELD>(static_cast<uint8_t>(8 * sizeof(Key)), ReplQuant{});
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  TReplSchema<ID_T>& TReplSchema<ID_T>::field(uint8_t bits)
+  {
+    using Key = FieldKeyT<FIELD>;
+    static_assert(std::is_integral_v<Key> || std::is_enum_v<Key>, "Only integer fields can be narrowed, quantize floating point fields.");
+    if (bits == 0 || bits > 8 * sizeof(Key))
+      throw std::runtime_error{ "Field width out of range!" };
+    return add_field<FIELD>(bits, ReplQuant{});
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  TReplSchema<ID_T>& TReplSchema<ID_T>::field(ReplQuant quant)
+  {
+    static_assert(std::is_floating_point_v<FieldKeyT<FIELD>>, "Only floating point fields can be quantized.");
+    if (quant.bits == 0 || quant.bits > 32 || !(quant.min < quant.max))
+      throw std::runtime_error{ "Invalid quantization!" };
+    return add_field<FIELD>(quant.bits, quant);
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  TReplSchema<ID_T>& TReplSchema<ID_T>::add_field(uint8_t bits, ReplQuant quant)
+  {
+    using Comp = FieldCompT<FIELD>;
+    using Key = FieldKeyT<FIELD>;
+    static_assert(std::is_arithmetic_v<Key> || std::is_enum_v<Key>, "Replicated fields must be arithmetic or enum types.");
+
+    ReplType<ID_T>& t = type<Comp>();
+    if (t.raw)
+    {
+      // Listing a field replaces the whole-component words.
+      t.raw = false;
+      t.fields.clear();
+    }
+    if (t.fields.size() == replMaxFields)
+      throw std::runtime_error{ "Too many replicated fields!" };
+
+    ReplField f{};
+    f.bits = bits;
+    f.quant = quant;
+    f.get = [](void const* comp, ReplField const& field) -> uint64_t
+    {
+      return encode<Key>(static_cast<Comp const*>(comp)->*FIELD, field);
+    };
+    f.set = [](void* comp, uint64_t value, ReplField const& field)
+    {
+      static_cast<Comp*>(comp)->*FIELD = decode<Key>(value, field);
+    };
+    t.fields.push_back(f);
+    return *this;
+  }
+
+  template<typename ID_T>
+  template<typename T>
+  uint64_t TReplSchema<ID_T>::encode(T value, ReplField const& field)
+  {
+    uint64_t const mask = field.bits == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << field.bits) - 1;
+    if constexpr (std::is_enum_v<T>)
+      return encode(static_cast<std::underlying_type_t<T>>(value), field);
+    else if constexpr (std::is_same_v<T, bool>)
+      return value ? 1 : 0;
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+      if (field.quant.bits > 0)
+      {
+        ReplQuant const& q = field.quant;
+        double const t = (std::clamp(static_cast<double>(value), q.min, q.max) - q.min) / (q.max - q.min);
+        return static_cast<uint64_t>(std::llround(t * static_cast<double>(mask)));
+      }
+      if constexpr (sizeof(T) == sizeof(uint32_t))
+      {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+      }
+      else
+      {
+        static_assert(sizeof(T) == sizeof(uint64_t), "Unsupported floating point type, quantize it instead.");
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+      }
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+      // Zigzag, so that small negative values keep their high bits clear.
+      int64_t const v = value;
+      return ((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)) & mask;
+    }
+    else
+      return static_cast<uint64_t>(value) & mask;
+  }
+
+  template<typename ID_T>
+  template<typename T>
+  T TReplSchema<ID_T>::decode(uint64_t value, ReplField const& field)
+  {
+    if constexpr (std::is_enum_v<T>)
+      return static_cast<T>(decode<std::underlying_type_t<T>>(value, field));
+    else if constexpr (std::is_same_v<T, bool>)
+      return value != 0;
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+      if (field.quant.bits > 0)
+      {
+        ReplQuant const& q = field.quant;
+        double const steps = static_cast<double>((uint64_t{ 1 } << q.bits) - 1);
+        return static_cast<T>(q.min + (q.max - q.min) * (static_cast<double>(value) / steps));
+      }
+      if constexpr (sizeof(T) == sizeof(uint32_t))
+      {
+        uint32_t const bits = static_cast<uint32_t>(value);
+        T v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+      }
+      else
+      {
+        T v;
+        std::memcpy(&v, &value, sizeof(v));
+        return v;
+      }
+    }
+    else if constexpr (std::is_signed_v<T>)
+      return static_cast<T>(static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1)));
+    else
+      return static_cast<T>(value);
+  }
+
+  // TReplicator ////////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  TReplicator<ID_T>::TReplicator(TWorld<ID_T>& world, TReplSchema<ID_T> const& schema)
+    : world_{ world }, schema_{ schema }, current_(schema.types().size()), previous_(schema.types().size()) {}
+
+  template<typename ID_T>
+  typename TReplicator<ID_T>::Peer TReplicator<ID_T>::peer_add()
+  {
+    Peer peer = 0;
+    while (peer < peers_.size() && peers_[peer].live)
+      ++peer;
+    if (peer == peers_.size())
+      peers_.emplace_back();
+    peers_[peer].live = true;
+    peer_reset(peer);
+    return peer;
+  }
+
+  template<typename ID_T>
+  void TReplicator<ID_T>::peer_remove(Peer peer)
+  {
+    peers_.at(peer) = PeerData{};
+  }
+
+  template<typename ID_T>
+  void TReplicator<ID_T>::peer_reset(Peer peer)
+  {
+    // An empty baseline of its own, which encodes as the whole state.
+    PeerData& data = peers_.at(peer);
+    data.update = 0;
+    data.base.resize(schema_.types().size());
+    for (ReplState<ID_T>& state : data.base)
+    {
+      state.ids.clear();
+      state.values.clear();
+    }
+  }
+
+  template<typename ID_T>
+  void TReplicator<ID_T>::update()
+  {
+    // Peers that were not sent the last update lose previous_ as their
+    // baseline, so they take a copy of it.
+    for (PeerData& data : peers_)
+    {
+      if (data.live && data.update != 0 && data.update + 1 == update_)
+        data.base = previous_;
+    }
+
+    std::swap(previous_, current_);
+    ++update_;
+    std::vector<ReplType<ID_T>> const& types = schema_.types();
+    for (size_t t = 0; t < types.size(); ++t)
+      types[t].gather(world_, types[t], current_[t], order_);
+  }
+
+  template<typename ID_T>
+  void TReplicator<ID_T>::encode(Peer peer, std::vector<uint8_t>& packet)
+  {
+    PeerData& data = peers_.at(peer);
+    if (!data.live)
+      throw std::runtime_error{ "Unknown peer!" };
+
+    if (data.update != 0 && data.update + 1 == update_)
+    {
+      if (sharedUpdate_ != update_)
+      {
+        write_diff(previous_, shared_);
+        sharedUpdate_ = update_;
+      }
+      packet.assign(shared_.begin(), shared_.end());
+    }
+    else if (data.update == update_)
+      write_diff(current_, packet);
+    else
+    {
+      write_diff(data.base, packet);
+      data.base.clear();
+      data.base.shrink_to_fit();
+    }
+    data.update = update_;
+  }
+
+  template<typename ID_T>
+  void TReplicator<ID_T>::write_diff(std::vector<ReplState<ID_T>> const& bases, std::vector<uint8_t>& packet) const
+  {
+    packet.clear();
+    ReplBitWriter out{ packet };
+    std::vector<ReplType<ID_T>> const& types = schema_.types();
+    for (size_t t = 0; t < types.size(); ++t)
+    {
+      std::vector<ReplField> const& fields = types[t].fields;
+      size_t const nFields = fields.size();
+      ReplState<ID_T> const& cur = current_[t];
+      ReplState<ID_T> const& base = bases[t];
+
+      // Both lists are sorted by id, so one merge pass finds every change.
+      uint64_t next = 0;
+      auto record = [&](ID_T id)
+      {
+        out.write(1, 1);
+        out.write_var(static_cast<uint64_t>(id) - next);
+        next = static_cast<uint64_t>(id) + 1;
+      };
+      auto values = [&](uint64_t const* v, uint64_t mask)
+      {
+        for (size_t f = 0; f < nFields; ++f)
+        {
+          if (mask & (uint64_t{ 1 } << f))
+            out.write(v[f], fields[f].bits);
+        }
+      };
+      uint64_t const all = nFields == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << nFields) - 1;
+
+      size_t i = 0, j = 0;
+      while (i < cur.ids.size() || j < base.ids.size())
+      {
+        if (j == base.ids.size() || (i < cur.ids.size() && cur.ids[i] < base.ids[j]))
+        {
+          record(cur.ids[i]);
+          out.write(0b10, 2);
+          values(cur.values.data() + i * nFields, all);
+          ++i;
+        }
+        else if (i == cur.ids.size() || base.ids[j] < cur.ids[i])
+        {
+          record(base.ids[j]);
+          out.write(0b00, 2);
+          ++j;
+        }
+        else
+        {
+          uint64_t const* c = cur.values.data() + i * nFields;
+          uint64_t const* b = base.values.data() + j * nFields;
+          if (nFields > 0 && std::memcmp(c, b, nFields * sizeof(uint64_t)) != 0)
+          {
+            uint64_t mask = 0;
+            for (size_t f = 0; f < nFields; ++f)
+            {
+              if (c[f] != b[f])
+                mask |= uint64_t{ 1 } << f;
+            }
+            record(cur.ids[i]);
+            out.write(1, 1);
+            out.write(mask, static_cast<unsigned>(nFields));
+            values(c, mask);
+          }
+          ++i;
+          ++j;
+        }
+      }
+      out.write(0, 1);
+    }
+    out.flush();
+  }
+
+  // TReplReceiver //////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  TReplReceiver<ID_T>::TReplReceiver(TWorld<ID_T>& world, TReplSchema<ID_T> const& schema)
+    : world_{ world }, schema_{ schema } {}
+
+  template<typename ID_T>
+  void TReplReceiver<ID_T>::apply(uint8_t const* data, size_t size)
+  {
+    ReplBitReader in{ data, size };
+    for (ReplType<ID_T> const& type : schema_.types())
+    {
+      std::vector<ReplField> const& fields = type.fields;
+      size_t const nFields = fields.size();
+      uint64_t const all = nFields == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << nFields) - 1;
+
+      auto set = [&](void* comp, uint64_t mask)
+      {
+        for (size_t f = 0; f < nFields; ++f)
+        {
+          if (mask & (uint64_t{ 1 } << f))
+            fields[f].set(comp, in.read(fields[f].bits), fields[f]);
+        }
+      };
+
+      uint64_t next = 0;
+      while (in.read(1) == 1)
+      {
+        ID_T const remote = static_cast<ID_T>(next + in.read_var());
+        next = static_cast<uint64_t>(remote) + 1;
+        auto it = mirrors_.find(remote);
+
+        if (in.read(1) == 1)
+        {
+          uint64_t const mask = in.read(static_cast<unsigned>(nFields));
+          void* comp = it == mirrors_.end() ? nullptr : type.get(world_, it->second.local);
+          if (comp == nullptr)
+            throw std::runtime_error{ "Replication stream is out of sync!" };
+          set(comp, mask);
+          type.changed(world_, it->second.local);
+        }
+        else if (in.read(1) == 1)
+        {
+          if (it == mirrors_.end())
+            it = mirrors_.emplace(remote, Mirror{ world_.entity_new(), 0 }).first;
+          else if (type.get(world_, it->second.local) != nullptr)
+            throw std::runtime_error{ "Replication stream is out of sync!" };
+          ++it->second.comps;
+          set(type.add(world_, it->second.local), all);
+          type.changed(world_, it->second.local);
+        }
+        else
+        {
+          if (it == mirrors_.end())
+            throw std::runtime_error{ "Replication stream is out of sync!" };
+          type.remove(world_, it->second.local);
+          if (--it->second.comps == 0)
+          {
+            world_.entity_destroy(it->second.local);
+            mirrors_.erase(it);
+          }
+        }
+      }
+    }
+  }
+
+  template<typename ID_T>
+  typename TReplReceiver<ID_T>::Entity TReplReceiver<ID_T>::local(ID_T remote) const
+  {
+    auto it = mirrors_.find(remote);
+    return it == mirrors_.end() ? Entity::invalid() : Entity{ it->second.local };
+  }
+} // namespace __detail
+
+// ALIASES ////////////////////////////////////////////////////////////////////
+
+using ReplSchema = __detail::TReplSchema<IdT>;
+using Replicator = __detail::TReplicator<IdT>;
+using ReplReceiver = __detail::TReplReceiver<IdT>;
+
+
+// EXAMPLES ///////////////////////////////////////////////////////////////////
+
+namespace {
+  inline void example_replication_func() {
+    struct Health { int32_t hp; };
+    struct Body { float x; float y; int16_t heading; };
+
+    // Both sides build the same schema. Health is sent whole. Body is sent
+    // field by field: the position quantized to 18 bits over [-1000, 1000],
+    // so steps under a hundredth, and the heading, which is signed, narrowed
+    // to 10 bits, enough for -512 to 511.
+    ReplSchema schema;
+    schema.comp<Health>();
+    schema.field<&Body::x>(ReplQuant{ -1000., 1000., 18 });
+    schema.field<&Body::y>(ReplQuant{ -1000., 1000., 18 });
+    schema.field<&Body::heading>(10);
+
+    World server;
+    Replicator replicator{ server, schema };
+
+    // Two clients, each with its own transport. The second one will skip an
+    // update.
+    World client, lateClient;
+    ReplReceiver receiver{ client, schema }, lateReceiver{ lateClient, schema };
+    ReplLoopback link, lateLink;
+    Replicator::Peer peer = replicator.peer_add();
+    Replicator::Peer latePeer = replicator.peer_add();
+
+    std::vector<uint8_t> packet;
+    auto send = [&](Replicator::Peer p, ReplLoopback& l, ReplReceiver& r) {
+      replicator.encode(p, packet);
+      l.send(packet);
+      while (l.receive(packet))
+        r.apply(packet);
+    };
+
+    World::Entity a = server.entity_new();
+    World::Entity b = server.entity_new();
+    server.comp_add<Health>(a, 100);
+    server.comp_add<Body>(a, 1.f, 2.f, int16_t(-90));
+    server.comp_add<Health>(b, 50);
+
+    // The first packet of each peer holds the whole state.
+    replicator.update();
+    send(peer, link, receiver);
+    send(latePeer, lateLink, lateReceiver);
+
+    // Only the fields that changed are sent: x and the heading of a's Body,
+    // the removal of a's Health and of b, whose last replicated component
+    // goes with it, so the client destroys its mirror of b.
+    server.comp_get<Body>(a)->x += 0.25f;
+    server.comp_get<Body>(a)->heading = -100;
+    server.comp_remove<Health>(a);
+    server.entity_destroy(b);
+    replicator.update();
+    send(peer, link, receiver);
+
+    // The late peer skipped the update above. It is sent everything that
+    // changed since its own last packet, in one packet.
+    server.comp_add<Health>(a, 75);
+    replicator.update();
+    send(peer, link, receiver);
+    send(latePeer, lateLink, lateReceiver);
+
+    // Both clients now mirror a, and no longer have b.
+    auto print = [&](World& w, ReplReceiver& r) {
+      World::Entity m = r.local(a);
+      Body const* body = w.comp_get<Body>(m);
+      printf("hp %i, x %.2f, heading %i, b mirrored: %i\n", w.comp_get<Health>(m)->hp,
+        body->x, body->heading, r.local(b) != World::Entity::invalid());
+    };
+    print(client, receiver);
+    print(lateClient, lateReceiver);
+    printf("%zu bytes sent\n", link.bytes_sent() + lateLink.bytes_sent());
+  }
+}
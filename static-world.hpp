@@ -0,0 +1,644 @@
+///@file   static-world.hpp
+///@author Chris Newman
+///@brief  World variant whose component types are fixed at compile time.
+#pragma once
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "world.hpp"
+
+namespace __detail
+{
+  /// Number of times T appears in TS.
+  template<typename T, typename ...TS>
+  constexpr size_t type_count_v = (size_t{ std::is_same_v<T, TS> } + ... + 0);
+
+  ///@return Position of T in TS, or the size of TS if it is not there.
+  template<typename T, typename ...TS>
+  constexpr size_t type_index()
+  {
+    size_t i = 0;
+    bool found = false;
+    ((found = found || std::is_same_v<T, TS>, i += !found), ...);
+    return i;
+  }
+
+  // TStaticWorld ///////////////////////////////////////////////////////////////
+  ///@brief World whose component types are all listed up front. The component
+  ///       arrays are held in a tuple, so every lookup is resolved at compile
+  ///       time, without type ids, registry lookups or casts, and iteration
+  ///       can be inlined. Provides the same entity, component, resource,
+  ///       view and system interface as `TWorld`, and runs the same systems.
+  ///       Staging buffers, prefabs, memory compaction and coroutines are
+  ///       only available on `TWorld`.
+  template<typename ID_T, typename ...COMPS>
+  class TStaticWorld
+  {
+    static_assert(std::is_integral<ID_T>::value, "ID_T must be an integer type.");
+    static_assert(std::is_unsigned<ID_T>::value, "ID_T must be unsigned.");
+    static_assert(sizeof...(COMPS) > 0, "One or more component names required");
+    static_assert(((type_count_v<COMPS, COMPS...> == 1) && ...), "Component types must be unique.");
+    static_assert(((!std::is_const_v<COMPS> && !std::is_pointer_v<COMPS> && !std::is_reference_v<COMPS>) && ...),
+      "Component types must be plain types.");
+
+    template<typename C>
+    using Bare = std::remove_const_t<std::remove_pointer_t<C>>;
+
+  public:
+    /// Entity type returned by / passed into functions.
+    using Entity = TEntity<ID_T>;
+
+    /// Types of events that system objects can be bound to.
+    using EventTypes = typename TWorld<ID_T>::EventTypes;
+
+    /// True if the component type is one of the world's types.
+    template<typename COMP>
+    static constexpr bool has_comp = type_count_v<Bare<COMP>, COMPS...> == 1;
+
+    /// Key of a component type in the index registry, its position in the
+    /// world's types.
+    template<typename COMP>
+    static constexpr uint32_t comp_key = static_cast<uint32_t>(type_index<Bare<COMP>, COMPS...>());
+
+    // World objects can not be moved or copied.
+    TStaticWorld() = default;
+    TStaticWorld(TStaticWorld const&) = delete;
+    TStaticWorld(TStaticWorld&&) = delete;
+    ~TStaticWorld();
+
+    ///@brief Gets the ID of a new entity.
+    Entity entity_new() { return nextId_++; }
+
+    ///@brief   Removes all components assigned to the given entity.
+    ///@param e The entity to be destroyed.
+    void entity_destroy(Entity e);
+
+    ///@brief   Adds the given entity to a list of entities to be removed after
+    ///         the completion of the next world tick.
+    ///@param e The entity to be destroyed.
+    void entity_destroy_delayed(Entity e) { removeList_.push_back(e); }
+
+    ///@brief Removes all entities on the removal list and clears it.
+    void process_remove();
+
+    ///@brief      Adds the given component type to an entity, constructed
+    ///            using the given arguments.
+    ///@param e    The entity ID to attach the component to.
+    ///@param args The arguments to pass to the component's constructor.
+    template<typename COMP, typename ...ARGS>
+    void comp_add(Entity e, ARGS&&... args)
+    {
+      array<COMP>().insert(e.id_, std::forward<ARGS>(args)...);
+      if (!indexReg_.empty())
+        indexReg_.update(comp_key<COMP>, e.id_);
+    }
+
+    ///@brief   Removes the given component type from the given entity, if
+    ///         possible.
+    ///@param e The entity ID to remove from.
+    template<typename COMP>
+    void comp_remove(Entity e)
+    {
+      array<COMP>().remove(e.id_);
+      if (!indexReg_.empty())
+        indexReg_.update(comp_key<COMP>, e.id_);
+    }
+
+    ///@brief   Gets the component of the given type from the given entity.
+    ///@param e The entity ID to get from.
+    ///@return  Non-owning pointer to the attached component, or `nullptr`.
+    template<typename COMP>
+    COMP* comp_get(Entity e) { return array<COMP>().get(e.id_); }
+
+    ///@brief   Gets the component of the given type from the given entity for
+    ///         reading only, see `TWorld::comp_latest`.
+    ///@param e The entity ID to get from.
+    ///@return  Non-owning pointer to the attached component, or `nullptr`.
+    template<typename COMP>
+    COMP const* comp_latest(Entity e) { return __detail::comp_latest<COMP>(&array<COMP>(), e.id_); }
+
+    ///@brief  Returns the array of all components of type `COMP`. Only
+    ///        available for packed component types.
+    ///@return Array view of all components of type `COMP`.
+    template<typename COMP>
+    TArrayView<COMP> comp_get();
+
+    ///@brief  Returns the ids of all entities with a component of type `COMP`,
+    ///        in the same order as the array returned by `comp_get`.
+    ///@return Array view of entity ids.
+    template<typename COMP>
+    TArrayView<ID_T> comp_get_entities() { return array<COMP>().ids(); }
+
+    ///@brief       Gets the entity that owns component of type `COMP` of
+    ///             the given index.
+    ///@param index The index of the component being tested.
+    ///@return      The entity the component is attached to.
+    template<typename COMP>
+    Entity comp_get_entity(size_t index) { return array<COMP>().get_id(index); }
+
+    ///@brief      Gets the entity that owns the given component.
+    ///@param comp The component being tested.
+    ///@return     The entity the component is attached to. If it could not
+    ///            be found, value of `Entity::invalid()` is returned instead.
+    template<typename COMP>
+    Entity comp_get_entity(COMP& comp) { return array<Bare<COMP>>().get_id(comp); }
+
+    ///@brief Sorts the components of type `COMP` by entity id.
+    template<typename COMP>
+    void comp_sort() { array<COMP>().sort_by_id(); }
+
+    ///@brief      Sets whether the components of type `COMP` are kept sorted by
+    ///            entity id, see `TWorld::comp_keep_sorted`.
+    ///@param keep True to keep the array sorted.
+    template<typename COMP>
+    void comp_keep_sorted(bool keep = true) { array<COMP>().set_sort_mode(keep); }
+
+    ///@brief         Switches the id mapping of the components of type `COMP`,
+    ///               see `TWorld::comp_set_storage`.
+    ///@param storage The mapping to use.
+    template<typename COMP>
+    void comp_set_storage(CompStorage storage)
+    {
+      array<COMP>().set_storage(storage);
+      array<COMP>().pin_storage(true);
+    }
+
+    ///@return The id mapping currently used by the components of type `COMP`.
+    template<typename COMP>
+    CompStorage comp_storage() { return array<COMP>().storage(); }
+
+    ///@brief        Sets whether component arrays switch to their suggested
+    ///              storage at the end of each tick, see
+    ///              `TWorld::comp_auto_storage`.
+    ///@param enable True to adapt storage automatically.
+    void comp_auto_storage(bool enable = true) { autoStorage_ = enable; }
+
+    ///@brief   Gets a handle to the component of type `COMP` of the given
+    ///         entity.
+    ///@param e The entity the handle refers to.
+    template<typename COMP>
+    TCompHandle<COMP, ID_T> comp_handle(Entity e) { return { &array<COMP>(), e.id_ }; }
+
+    ///@brief  Reports per component type memory usage. Type ids are the
+    ///        positions of the types in the world's type list.
+    ///@return One entry per component type.
+    std::vector<CompMemoryStats> mem_stats();
+
+    ///@brief Releases spare capacity of every component array.
+    void mem_shrink();
+
+    ///@brief        Incrementally sorts component arrays by entity id, see
+    ///              `TWorld::mem_defrag`.
+    ///@param budget Time to spend. At least one step is always taken.
+    ///@return       True if every array is sorted.
+    bool mem_defrag(std::chrono::microseconds budget);
+
+    ///@brief        Sets the time spent on `mem_defrag` at the end of every
+    ///              tick.
+    ///@param budget Time per tick. Zero, the default, turns it off.
+    void mem_set_defrag_budget(std::chrono::microseconds budget) { defragBudget_ = budget; }
+
+    ///@brief      Creates a secondary index over the member `FIELD` of a
+    ///            component type, see `TWorld::index_add`.
+    ///@param kind The kind of index.
+    template<auto FIELD>
+    void index_add(CompIndex kind = CompIndex::hash);
+
+    ///@brief     Finds the entities whose `FIELD` equals the given key, see
+    ///           `TWorld::index_find`.
+    ///@param key The value to look for.
+    template<auto FIELD>
+    TArrayView<ID_T> index_find(FieldKeyT<FIELD> const& key);
+
+    ///@brief      Calls `func(Entity)` for every entity whose `FIELD` lies in
+    ///            `[lo, hi]`, see `TWorld::index_range`.
+    template<auto FIELD, typename FUNC>
+    void index_range(FieldKeyT<FIELD> const& lo, FieldKeyT<FIELD> const& hi, FUNC func);
+
+    ///@brief      Executes a given function on the components of every entity
+    ///            whose `FIELD` equals the key, see `TWorld::index_each`.
+    template<auto FIELD, typename ...COMP, typename FUNC>
+    void index_each(FieldKeyT<FIELD> const& key, FUNC func);
+
+    ///@brief   Updates the indexes over fields of `COMP` after the component
+    ///         of the given entity was changed through a reference.
+    template<typename COMP>
+    void comp_changed(Entity e) { indexReg_.update(comp_key<COMP>, e.id_); }
+
+    ///@brief      Sets the world's resource of type `RES`, replacing any
+    ///            existing one.
+    ///@param args The arguments to pass to the resource's constructor.
+    ///@return     The new resource.
+    template<typename RES, typename ...ARGS>
+    RES& res_set(ARGS&&... args)
+    {
+      return resReg_.template get_slot<RES>().emplace(std::forward<ARGS>(args)...);
+    }
+
+    ///@return Non-owning pointer to the resource of type `RES`, or `nullptr`
+    ///        if it has not been set.
+    template<typename RES>
+    RES* res_get() { return resReg_.template get_slot<RES>().get(); }
+
+    ///@brief Destroys the world's resource of type `RES`, if set.
+    template<typename RES>
+    void res_remove() { resReg_.template get_slot<RES>().reset(); }
+
+    ///@brief  Gets the slot holding the resource of type `RES`.
+    template<typename RES>
+    TResource<RES>& res_slot() { return resReg_.template get_slot<RES>(); }
+
+    ///@brief      Adds a system to be executed on the given event type. Every
+    ///            component type the system uses must be one of the world's.
+    ///@param evT  The type of event that fires the system.
+    ///@param args Arguments that are forwarded to the system's constructor
+    template<typename SYS, typename...CON_ARGS>
+    void sys_add(EventTypes evT, CON_ARGS&&...args);
+
+    ///@brief      Executes a given function on each matching set of the
+    ///            given component types.
+    ///@param func The function to be executed. Should take each of the given
+    ///            component types as references.
+    template<typename ...COMP, typename FUNC>
+    void each(FUNC func);
+
+    ///@brief Reduces the components of type `COMP`, see `TWorld::reduce`.
+    template<typename COMP, typename T, typename REDUCE>
+    T reduce(T init, REDUCE reduce)
+    {
+      return transform_reduce<COMP>(std::move(init), reduce, [](auto const& c) { return c; });
+    }
+
+    ///@brief Transforms and reduces every matching set of the given component
+    ///       types, see `TWorld::transform_reduce`.
+    template<typename ...COMP, typename T, typename REDUCE, typename TRANSFORM>
+    T transform_reduce(T init, REDUCE reduce, TRANSFORM transform);
+
+    ///@brief Calls all systems bound to tick events.
+    void tick();
+
+    ///@brief        Sets whether ticks are pipelined, see
+    ///              `TWorld::tick_pipelined`.
+    ///@param enable True to pipeline ticks.
+    void tick_pipelined(bool enable = true);
+
+    ///@brief Waits for the pipelined `tickEnd` systems of the previous tick,
+    ///       see `TWorld::tick_wait`.
+    void tick_wait();
+
+    ///@brief Gets a component view of the specified types. Join results are
+    ///       shared until the end of the tick, as with `TWorld::view_get`.
+    template<typename ...COMP>
+    TComponentView<ID_T, COMP...> view_get();
+
+    ///@brief Gets the arena for temporary data, reset at the end of every
+    ///       tick, see `TWorld::frame_arena`.
+    FrameArena& frame_arena() { return frameArena_; }
+
+    ///@brief Gets a lazily joined view of the specified types.
+    template<typename ...COMP>
+    TLazyView<ID_T, COMP...> view_lazy();
+
+  private:
+    ///@return The array of the given component type.
+    template<typename COMP>
+    TCompArray<Bare<COMP>, ID_T>& array()
+    {
+      static_assert(has_comp<COMP>, "Component type is not part of this world.");
+      return std::get<TCompArray<Bare<COMP>, ID_T>>(arrays_);
+    }
+
+    template<auto FIELD>
+    using HashIndex = THashIndex<FIELD, ID_T, TCompArray<FieldCompT<FIELD>, ID_T>>;
+    template<auto FIELD>
+    using OrderedIndex = TOrderedIndex<FIELD, ID_T, TCompArray<FieldCompT<FIELD>, ID_T>>;
+
+    ///@brief Waits for the running pipelined systems, then copies what they
+    ///       read, and the list of those systems, and starts them on the
+    ///       shared worker pool.
+    void pipeline_start();
+
+    std::tuple<TCompArray<COMPS, ID_T>...>   arrays_;
+    ID_T                                     nextId_ = 0;
+    bool                                     autoStorage_ = false;
+    std::chrono::microseconds                defragBudget_{ 0 };
+    TResourceRegistry                        resReg_;
+    TIndexRegistry<ID_T>                     indexReg_;
+    std::vector<SystemPackage<TStaticWorld>> sysTick_;
+    std::vector<SystemPackage<TStaticWorld>> sysTickBegin_;
+    std::vector<SystemPackage<TStaticWorld>> sysTickEnd_;
+    std::vector<Entity>                      removeList_;
+    FrameArena                               frameArena_;
+    ViewCache                                viewCache_;
+    bool                                     pipelined_ = false;
+    std::unique_ptr<TStaticWorld>            pipeWorld_;
+    std::vector<SystemBase<TStaticWorld>*>   pipeSystems_;
+    WorkerPool::Ticket                       pipeJob_;
+    PipelineDeps                             pipeDeps_;
+  };
+
+  // TStaticWorld ///////////////////////////////////////////////////////////////
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::entity_destroy(Entity e)
+  {
+    std::apply([&](auto&... arr) { (arr.remove(e.id_), ...); }, arrays_);
+    indexReg_.update_all(e.id_);
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::process_remove()
+  {
+    for (Entity e : removeList_)
+    {
+      entity_destroy(e);
+    }
+    removeList_.clear();
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<typename COMP>
+  TArrayView<COMP> TStaticWorld<ID_T, COMPS...>::comp_get()
+  {
+    static_assert(comp_layout_v<COMP> == CompLayout::packed,
+      "Only packed components are stored contiguously, use comp_get_entities and comp_get(Entity) instead.");
+    auto& vec = array<COMP>().array();
+    return TArrayView<COMP>{ vec.data(), vec.size() };
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  std::vector<CompMemoryStats> TStaticWorld<ID_T, COMPS...>::mem_stats()
+  {
+    std::vector<CompMemoryStats> ret;
+    std::apply([&](auto&... arr)
+    {
+      uint32_t i = 0;
+      ((ret.push_back(arr.memory_stats()), ret.back().typeId = i++), ...);
+    }, arrays_);
+    return ret;
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::mem_shrink()
+  {
+    std::apply([](auto&... arr) { (arr.shrink(), ...); }, arrays_);
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  bool TStaticWorld<ID_T, COMPS...>::mem_defrag(std::chrono::microseconds budget)
+  {
+    auto const start = std::chrono::steady_clock::now();
+    do
+    {
+      TEntitySet<ID_T>* next = nullptr;
+      auto pick = [&next](TEntitySet<ID_T>& set)
+      {
+        if (!set.is_sorted() && (!next || set.join_count() > next->join_count()))
+          next = &set;
+      };
+      std::apply([&](auto&... arr) { (pick(arr), ...); }, arrays_);
+      if (!next)
+        return true;
+      if (next->defrag_step(defragStep))
+        next->shrink();
+    } while (std::chrono::steady_clock::now() - start < budget);
+    return false;
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<auto FIELD>
+  void TStaticWorld<ID_T, COMPS...>::index_add(CompIndex kind)
+  {
+    using COMP = FieldCompT<FIELD>;
+    if (kind == CompIndex::hash)
+      indexReg_.template get<HashIndex<FIELD>>(array<COMP>(), comp_key<COMP>);
+    else
+      indexReg_.template get<OrderedIndex<FIELD>>(array<COMP>(), comp_key<COMP>);
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<auto FIELD>
+  TArrayView<ID_T> TStaticWorld<ID_T, COMPS...>::index_find(FieldKeyT<FIELD> const& key)
+  {
+    using COMP = FieldCompT<FIELD>;
+    return indexReg_.template get<HashIndex<FIELD>>(array<COMP>(), comp_key<COMP>).find(key);
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<auto FIELD, typename FUNC>
+  void TStaticWorld<ID_T, COMPS...>::index_range(FieldKeyT<FIELD> const& lo, FieldKeyT<FIELD> const& hi, FUNC func)
+  {
+    using COMP = FieldCompT<FIELD>;
+    indexReg_.template get<OrderedIndex<FIELD>>(array<COMP>(), comp_key<COMP>)
+      .range(lo, hi, [&](ID_T id) { return func(Entity{ id }); });
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<auto FIELD, typename ...COMP, typename FUNC>
+  void TStaticWorld<ID_T, COMPS...>::index_each(FieldKeyT<FIELD> const& key, FUNC func)
+  {
+    static_assert(sizeof...(COMP) > 0, "One or more component names required");
+    auto arrs = std::make_tuple(&array<COMP>()...);
+    for (ID_T id : index_find<FIELD>(key))
+    {
+      std::apply([&](auto*... arr)
+      {
+        std::tuple<decltype(comp_of<COMP>(arr, id))...> comps{ comp_of<COMP>(arr, id)... };
+        std::apply([&](auto*... comp)
+        {
+          if ((comp && ...))
+            func(*comp...);
+        }, comps);
+      }, arrs);
+    }
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<typename SYS, typename...CON_ARGS>
+  void TStaticWorld<ID_T, COMPS...>::sys_add(EventTypes evT, CON_ARGS&&...args)
+  {
+    static_assert(std::is_base_of_v<SystemBaseType, SYS>);
+    // Component types outside of the world are rejected by `array`.
+
+    // Binding a read-only system may add resource slots to the copy the
+    // pipelined systems are running on.
+    tick_wait();
+    SystemPackage<TStaticWorld> sp;
+    SYS* sys = new SYS(args...);
+    sys->bind_resources(*this);
+    sp.bPtr_ = std::make_unique<typename SystemPackage<TStaticWorld>::template Derived<SYS>>(sys);
+
+    switch (evT)
+    {
+    default:
+    case EventTypes::none:
+      break;
+    case EventTypes::tick:
+      sysTick_.push_back(std::move(sp));
+      break;
+    case EventTypes::tickBegin:
+      sysTickBegin_.push_back(std::move(sp));
+      break;
+    case EventTypes::tickEnd:
+      if constexpr (SYS::readOnly)
+      {
+        pipeDeps_.add(static_cast<typename SYS::CompTypesList*>(nullptr),
+          static_cast<typename SYS::ResTypesList*>(nullptr));
+        sp.readOnly_ = true;
+        if (pipelined_)
+          sp.bPtr_->bind(*pipeWorld_);
+      }
+      sysTickEnd_.push_back(std::move(sp));
+      break;
+    }
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<typename ...COMP, typename FUNC>
+  void TStaticWorld<ID_T, COMPS...>::each(FUNC func)
+  {
+    static_assert(sizeof...(COMP) > 0, "One or more component names required");
+    static_assert(std::is_invocable_v<FUNC, COMP&...>, "func must be callable type that takes given components as references.");
+
+    std::tuple<TCompArray<Bare<COMP>, ID_T>*...> arrs{ &array<COMP>()... };
+    each_arrays<ID_T, COMP...>(arrs, func, frameArena_);
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<typename ...COMP, typename T, typename REDUCE, typename TRANSFORM>
+  T TStaticWorld<ID_T, COMPS...>::transform_reduce(T init, REDUCE reduce, TRANSFORM transform)
+  {
+    static_assert(sizeof...(COMP) > 0, "One or more component names required");
+    if constexpr (sizeof...(COMP) == 1)
+      return transform_reduce_array<COMP...>(array<COMP...>(), std::move(init), reduce, transform);
+    else
+      return view_get<COMP...>().transform_reduce(std::move(init), reduce, transform);
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::tick()
+  {
+    for (auto& s : sysTickBegin_)
+    {
+      s.bPtr_->run(this);
+    }
+    for (auto& s : sysTick_)
+    {
+      s.bPtr_->run(this);
+    }
+    for (auto& s : sysTickEnd_)
+    {
+      if (!pipelined_ || !s.readOnly_)
+        s.bPtr_->run(this);
+    }
+    if (pipelined_)
+      pipeline_start();
+    // Publish what was written this tick to the readers of the next one.
+    std::apply([](auto&... arr) { (arr.swap_buffers(), ...); }, arrays_);
+    if (autoStorage_)
+      std::apply([](auto&... arr) { (arr.adapt_storage(), ...); }, arrays_);
+    // Joins only intersect arrays that are still sorted.
+    std::apply([](auto&... arr)
+    {
+      ((arr.sort_mode() && !arr.is_sorted() ? arr.sort_by_id() : void()), ...);
+    }, arrays_);
+    if (defragBudget_.count() > 0)
+      mem_defrag(defragBudget_);
+    // Cached joins only live for one tick, and so does the memory they use.
+    viewCache_.release();
+    frameArena_.reset();
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  TStaticWorld<ID_T, COMPS...>::~TStaticWorld()
+  {
+    if (pipeJob_.valid())
+      pipeJob_.wait();
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::tick_pipelined(bool enable)
+  {
+    tick_wait();
+    if (enable && !pipeWorld_)
+      pipeWorld_ = std::make_unique<TStaticWorld>();
+    pipelined_ = enable;
+    for (auto& s : sysTickEnd_)
+    {
+      if (s.readOnly_)
+        s.bPtr_->bind(enable ? *pipeWorld_ : *this);
+    }
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::tick_wait()
+  {
+    if (pipeJob_.valid())
+      pipeJob_.get();
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  void TStaticWorld<ID_T, COMPS...>::pipeline_start()
+  {
+    tick_wait();
+
+    // The copy is joined afresh every tick.
+    TStaticWorld& snap = *pipeWorld_;
+    snap.viewCache_.release();
+    snap.frameArena_.reset();
+    std::vector<uint32_t> const& keys = pipeDeps_.comps;
+    auto copy = [&keys](auto& dst, auto& src, uint32_t key)
+    {
+      if (std::find(keys.begin(), keys.end(), key) != keys.end())
+        dst.assign_from(src);
+    };
+    std::apply([&](auto&... dst)
+    {
+      std::apply([&](auto&... src)
+      {
+        (copy(dst, src, get_type_id<COMPS, ComponentFamily>()), ...);
+      }, arrays_);
+    }, snap.arrays_);
+    pipeDeps_.copy_res(resReg_, snap.resReg_);
+
+    // The job walks a list taken now rather than `sysTickEnd_` itself.
+    pipeSystems_.clear();
+    for (auto& s : sysTickEnd_)
+    {
+      if (s.readOnly_)
+        pipeSystems_.push_back(s.bPtr_.get());
+    }
+
+    pipeJob_ = WorkerPool::shared().submit([this, &snap]
+    {
+      for (SystemBase<TStaticWorld>* s : pipeSystems_)
+        s->run(&snap);
+    });
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<typename ...COMP>
+  TComponentView<ID_T, COMP...> TStaticWorld<ID_T, COMPS...>::view_get()
+  {
+    if constexpr (sizeof...(COMP) == 0)
+      return TComponentView<ID_T>{ this };
+    else
+    {
+      typename TComponentView<ID_T, COMP...>::Arrays arrs{ &array<COMP>()... };
+      return TComponentView<ID_T, COMP...>{ this, arrs, viewCache_.template get<ID_T, COMP...>(arrs, frameArena_) };
+    }
+  }
+
+  template<typename ID_T, typename ...COMPS>
+  template<typename ...COMP>
+  TLazyView<ID_T, COMP...> TStaticWorld<ID_T, COMPS...>::view_lazy()
+  {
+    return TLazyView<ID_T, COMP...>{ this, typename TLazyView<ID_T, COMP...>::Arrays{ &array<COMP>()... } };
+  }
+} // namespace __detail
+
+// ALIASES ////////////////////////////////////////////////////////////////////
+
+template<typename ...COMPS>
+using StaticWorld = __detail::TStaticWorld<IdT, COMPS...>;
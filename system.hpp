@@ -13,25 +13,106 @@
 
 class SystemBaseType {};
 
+///@brief Marks a resource dependency in a system's type list, e.g.
+///       `System<Position, Resource<const Clock>>`. A const resource type
+///       declares read-only access.
+template<typename RES>
+struct Resource {};
+
+namespace __detail
+{
+  template<typename T>
+  struct CompDep { using type = std::tuple<T>; };
+  template<typename T>
+  struct CompDep<Resource<T>> { using type = std::tuple<>; };
+
+  template<typename T>
+  struct ResDep { using type = std::tuple<>; };
+  template<typename T>
+  struct ResDep<Resource<T>> { using type = std::tuple<T>; };
+
+  /// Index of T in the tuple TUP.
+  template<typename T, typename TUP>
+  struct TypeIndex;
+  template<typename T, typename ...TS>
+  struct TypeIndex<T, std::tuple<T, TS...>> : std::integral_constant<size_t, 0> {};
+  template<typename T, typename U, typename ...TS>
+  struct TypeIndex<T, std::tuple<U, TS...>>
+    : std::integral_constant<size_t, 1 + TypeIndex<T, std::tuple<TS...>>::value> {};
+
+  /// Stand-in for the lazy view of systems without components.
+  struct NoLazyView {};
+
+  ///@brief Splits a system's dependency list into components and resources.
+  template<typename ID_T, typename COMPS, typename RES>
+  struct SystemDeps;
+
+  template<typename ID_T, typename ...COMPS, typename ...RES>
+  struct SystemDeps<ID_T, std::tuple<COMPS...>, std::tuple<RES...>>
+  {
+    static constexpr bool permissions[] = {std::is_const_v<COMPS>..., false};
+    static constexpr bool resPermissions[] = {std::is_const_v<RES>..., false};
+    /// True if every dependency is declared const, optional components
+    /// included, so running the system never changes the world.
+    static constexpr bool readOnly = sizeof...(COMPS) + sizeof...(RES) > 0
+      && (std::is_const_v<std::remove_pointer_t<COMPS>> && ...) && (std::is_const_v<RES> && ...);
+    using CompTypesList = std::tuple<std::remove_const_t<COMPS>...>;
+    using ResDeclList = std::tuple<RES...>;
+    using ResTypesList = std::tuple<std::remove_const_t<RES>...>;
+    using ResSlots = std::tuple<TResource<std::remove_const_t<RES>>*...>;
+    using ComponentView = TComponentView<ID_T, COMPS...>;
+    using LazyView = std::conditional_t<sizeof...(COMPS) == 0, NoLazyView, TLazyView<ID_T, COMPS...>>;
+
+    template<typename WORLD>
+    static ResSlots bind([[maybe_unused]] WORLD& world)
+    {
+      return ResSlots{ &world.template res_slot<std::remove_const_t<RES>>()... };
+    }
+  };
+
+  template<typename ID_T, typename ...DEPS>
+  using SystemDepsOf = SystemDeps<ID_T,
+    decltype(std::tuple_cat(std::declval<typename CompDep<DEPS>::type>()...)),
+    decltype(std::tuple_cat(std::declval<typename ResDep<DEPS>::type>()...))>;
+}
+
 ///@brief ECS system base type. Contains meta type data.
-template<typename ID_T, typename ...COMPS>
+template<typename ID_T, typename ...DEPS>
 class TSystem : public SystemBaseType
 {
+  using Deps = __detail::SystemDepsOf<ID_T, DEPS...>;
+  friend class __detail::TWorld<ID_T>;
+  template<typename, typename...>
+  friend class __detail::TStaticWorld;
+  template<typename>
+  friend struct __detail::SystemPackage;
 public:
   /// Read/write permissions for each component
-  static constexpr bool permissions[] = {std::is_const_v<COMPS>..., false};
+  static constexpr auto& permissions = Deps::permissions;
+  /// Read/write permissions for each resource
+  static constexpr auto& resPermissions = Deps::resPermissions;
   /// A tuple of all component types operated on by this system.
-  using CompTypesList = std::tuple<std::remove_const_t<COMPS>...>;
+  using CompTypesList = typename Deps::CompTypesList;
   /// Type corresponding to index I
   template<size_t I>
   using CompType = std::tuple_element_t<I, CompTypesList>;
   /// Number of component types operated on by this system.
   static constexpr size_t compsNum = std::tuple_size_v<CompTypesList>;
+  /// A tuple of all resource types used by this system.
+  using ResTypesList = typename Deps::ResTypesList;
+  /// Number of resource types used by this system.
+  static constexpr size_t resNum = std::tuple_size_v<ResTypesList>;
+  /// True if the system only reads the world, see `TWorld::tick_pipelined`.
+  static constexpr bool readOnly = Deps::readOnly;
   //static_assert(compsNum > 0);
 
   virtual ~TSystem() = default;
 
-  using ComponentView = TComponentView<ID_T, COMPS...>;
+  using ComponentView = typename Deps::ComponentView;
+  using LazyView = typename Deps::LazyView;
+  /// Systems that hide this with `true` are passed a `LazyView` instead of a
+  /// `ComponentView`, and should implement the matching operator().
+  static constexpr bool lazyView = false;
 
   virtual void operator()(ComponentView arg)
   {
@@ -39,10 +120,38 @@ public:
     throw std::runtime_error{ "operator() not implemented!" };
   }
 
+  virtual void operator()(LazyView)
+  {
+    throw std::runtime_error{ "operator() not implemented!" };
+  }
+
   virtual void operator()()
   {
     throw std::runtime_error{ "operator() not implemented!" };
   }
+
+protected:
+  ///@brief  Gets a resource declared in the system's type list. Resources
+  ///        declared const are returned as const.
+  ///@return Reference to the world's resource. Throws if it is not set.
+  template<typename RES>
+  auto& res()
+  {
+    using Key = std::remove_const_t<RES>;
+    constexpr size_t I = __detail::TypeIndex<Key, ResTypesList>::value;
+    using Decl = std::tuple_element_t<I, typename Deps::ResDeclList>;
+
+    Key* ptr = std::get<I>(resSlots_)->get();
+    if (!ptr)
+      throw std::runtime_error{ "Resource not set!" };
+    return static_cast<Decl&>(*ptr);
+  }
+
+private:
+  template<typename WORLD>
+  void bind_resources(WORLD& world) { resSlots_ = Deps::bind(world); }
+
+  typename Deps::ResSlots resSlots_;
 };
 
 // Type that a system class should derive from.
@@ -77,12 +186,45 @@ public:
       printf(std::to_string(s.entity).c_str());
       printf("\n");
     }
+    // Sets are tuple-like, with the entity first, so they can be unpacked.
+    // Components are bound by reference.
+    for (auto [ent, i, i2] : cv)
+      printf("%u: %i %s\n", ent, i, i2 ? "Yes" : "No");
     // You can also use operator[] on a ComponentView
 
     // World can be accessed through cv.source()
   }
 };
 
+// Example of a system using a lazy view. Only the entities up to the first
+// match are visited, and nothing is allocated.
+class SystemSampleLazy : public System<int32_t, const int64_t>
+{
+public:
+  static constexpr bool lazyView = true;
+
+  void operator()(LazyView lv) override
+  {
+    if (auto s = lv.find_if([](auto const& set) { return set.b > 50000; }))
+      printf("First big one: %u\n", s->entity);
+  }
+};
+
+// Example of a system using a resource.
+struct SampleClock { float dt = 1.f / 60.f; };
+
+class SystemSampleRes : public System<float, Resource<const SampleClock>>
+{
+public:
+  // Resources are bound when the system is added to the world, so res<>()
+  // involves no lookup in the world's registries.
+  void operator()(ComponentView cv) override
+  {
+    float dt = res<SampleClock>().dt;
+    cv.each([dt](float& f) { f += dt; });
+  }
+};
+
 namespace {
   inline void example_system_func() {
     World world;
@@ -96,8 +238,13 @@ namespace {
         world.comp_add<int64_t>(e, i * 1000);
     }
 
-    // Add the example system defined above to the world.
+    // Resources hold global state that does not belong to an entity.
+    world.res_set<SampleClock>();
+
+    // Add the example systems defined above to the world.
     world.sys_add<SystemSample>(World::EventTypes::tick);
+    world.sys_add<SystemSampleRes>(World::EventTypes::tick);
+    world.sys_add<SystemSampleLazy>(World::EventTypes::tick);
     // Activate all attached systems.
     world.tick();
   }
@@ -0,0 +1,254 @@
+///@file   worker-pool.hpp
+///@author Chris Newman
+///@brief  Persistent worker threads shared by parallel reductions and
+///        pipelined ticks.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace __detail
+{
+  // WorkerPool /////////////////////////////////////////////////////////////////
+  ///@brief Fixed set of worker threads that run queued jobs, so that work
+  ///       handed off every tick does not pay for starting threads. Jobs
+  ///       may queue further jobs and call `parallel_for` themselves.
+  class WorkerPool
+  {
+    struct Done;
+  public:
+    ///@brief Handle to a job queued with `submit`.
+    class Ticket
+    {
+    public:
+      ///@return True if the job has not been waited for with `get` yet.
+      bool valid() const { return done_ != nullptr; }
+      ///@brief Waits for the job.
+      void wait() const;
+      ///@brief Waits for the job and rethrows what it threw, if anything.
+      ///       The ticket is no longer valid afterwards.
+      void get();
+    private:
+      friend class WorkerPool;
+      std::shared_ptr<Done> done_;
+    };
+
+    ///@param threads Number of worker threads, at least one.
+    explicit WorkerPool(size_t threads);
+    ///@brief Runs the jobs still queued, then stops the workers.
+    ~WorkerPool();
+
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+
+    ///@return The pool shared by every world, with one worker less than
+    ///        there are hardware threads, so the calling thread has one.
+    static WorkerPool& shared();
+
+    ///@return Number of worker threads.
+    size_t size() const { return threads_.size(); }
+
+    ///@brief     Queues a job to run on one of the workers.
+    ///@param job Called without arguments. Must be copyable.
+    ///@return    Ticket to wait for the job with.
+    template<typename FUNC>
+    Ticket submit(FUNC job);
+
+    ///@brief         Calls `func(i)` for every `i` in `[0, count)`. The
+    ///               calling thread takes part, and up to `threads - 1`
+    ///               workers help as they become free, so a busy pool only
+    ///               slows the loop down. Returns once every call is done,
+    ///               rethrowing the first exception any of them threw.
+    ///@param count   Number of calls.
+    ///@param threads Maximum number of threads to use, including the caller.
+    ///@param func    Called as `func(size_t)`. Must be safe to call from
+    ///               several threads at once.
+    template<typename FUNC>
+    void parallel_for(size_t count, size_t threads, FUNC& func);
+
+  private:
+    ///@brief Completion of a submitted job. Everything the job leaves behind
+    ///       is handed over under the mutex, so the waiting thread owns it
+    ///       once it sees `done`.
+    struct Done
+    {
+      std::mutex              mutex;
+      std::condition_variable finished;
+      bool                    done = false;
+      std::exception_ptr      error;
+    };
+
+    ///@brief Progress of one `parallel_for`. Owned jointly by its helper
+    ///       jobs, since those may not get to run before the loop returns.
+    struct Loop
+    {
+      void                    (*call)(void* func, size_t i);
+      void*                   func;
+      size_t                  count;
+      std::atomic<size_t>     next{ 0 };
+      std::atomic<size_t>     done{ 0 };
+      std::mutex              mutex;
+      std::condition_variable finished;
+      std::exception_ptr      error;
+
+      ///@brief Makes calls until none are left to claim.
+      void run();
+    };
+
+    void push(std::function<void()> job);
+    void work();
+
+    std::vector<std::thread>          threads_;
+    std::mutex                        mutex_;
+    std::condition_variable           wake_;
+    std::deque<std::function<void()>> jobs_;
+    bool                              stop_ = false;
+  };
+
+  // WorkerPool /////////////////////////////////////////////////////////////////
+  inline WorkerPool::WorkerPool(size_t threads)
+  {
+    threads = std::max<size_t>(1, threads);
+    threads_.reserve(threads);
+    for (size_t t = 0; t < threads; ++t)
+      threads_.emplace_back([this] { work(); });
+  }
+
+  inline WorkerPool::~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : threads_)
+      t.join();
+  }
+
+  inline WorkerPool& WorkerPool::shared()
+  {
+    static WorkerPool pool{ std::max(2u, std::thread::hardware_concurrency()) - 1 };
+    return pool;
+  }
+
+  template<typename FUNC>
+  WorkerPool::Ticket WorkerPool::submit(FUNC job)
+  {
+    Ticket ticket;
+    ticket.done_ = std::make_shared<Done>();
+    push([job = std::move(job), done = ticket.done_]() mutable
+    {
+      std::exception_ptr error;
+      try
+      {
+        job();
+      }
+      catch (...)
+      {
+        error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock{ done->mutex };
+      done->error = std::move(error);
+      done->done = true;
+      done->finished.notify_all();
+    });
+    return ticket;
+  }
+
+  template<typename FUNC>
+  void WorkerPool::parallel_for(size_t count, size_t threads, FUNC& func)
+  {
+    if (count == 0)
+      return;
+
+    auto loop = std::make_shared<Loop>();
+    loop->call = [](void* f, size_t i) { (*static_cast<FUNC*>(f))(i); };
+    loop->func = &func;
+    loop->count = count;
+
+    size_t const helpers = std::min(std::max<size_t>(1, threads), std::min(count, size() + 1)) - 1;
+    for (size_t t = 0; t < helpers; ++t)
+      push([loop] { loop->run(); });
+    loop->run();
+
+    // Calls claimed by helpers may still be running.
+    std::unique_lock<std::mutex> lock{ loop->mutex };
+    loop->finished.wait(lock, [&] { return loop->done.load() == count; });
+    if (loop->error)
+      std::rethrow_exception(loop->error);
+  }
+
+  inline void WorkerPool::Loop::run()
+  {
+    for (size_t i = next++; i < count; i = next++)
+    {
+      try
+      {
+        call(func, i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (!error)
+          error = std::current_exception();
+      }
+      if (++done == count)
+      {
+        std::lock_guard<std::mutex> lock{ mutex };
+        finished.notify_all();
+      }
+    }
+  }
+
+  inline void WorkerPool::push(std::function<void()> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock{ mutex_ };
+      jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+  }
+
+  inline void WorkerPool::work()
+  {
+    for (;;)
+    {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock{ mutex_ };
+        wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (jobs_.empty())
+          return;
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      job();
+    }
+  }
+
+  // WorkerPool::Ticket /////////////////////////////////////////////////////////
+  inline void WorkerPool::Ticket::wait() const
+  {
+    std::unique_lock<std::mutex> lock{ done_->mutex };
+    done_->finished.wait(lock, [this] { return done_->done; });
+  }
+
+  inline void WorkerPool::Ticket::get()
+  {
+    wait();
+    std::exception_ptr error = std::move(done_->error);
+    done_.reset();
+    if (error)
+      std::rethrow_exception(error);
+  }
+} // namespace __detail
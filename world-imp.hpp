@@ -5,21 +5,30 @@
 
 #include <type_traits>
 #include <memory>
+#include <algorithm>
+#include <numeric>
+#include <array>
 
 #include "component-view.hpp"
+#include "lazy-view.hpp"
 #include "world.hpp"
 #include "system.hpp"
 
 namespace __detail
 {
-  template<typename ID_T>
+  template<typename WORLD>
+  struct SystemBase
+  {
+    virtual void run(WORLD* w) = 0;
+    // Points the system's resource slots at the given world.
+    virtual void bind(WORLD& w) = 0;
+    virtual ~SystemBase() = default;
+  };
+
+  template<typename WORLD>
   struct SystemPackage
   {
-    struct Base
-    {
-      virtual void run(TWorld<ID_T>* w) = 0;
-      virtual ~Base() = default;
-    };
+    using Base = SystemBase<WORLD>;
     template<typename SYS>
     struct Derived : Base
     {
@@ -28,183 +37,2066 @@ namespace __detail
       Derived(SYS* sysPtr)
         : sysPtr_(sysPtr) {}
 
-      template<size_t... IS>
-      void run_each_caller(TWorld<ID_T>* w, std::index_sequence<IS...>)
+      template<typename ID_T, typename ...COMPS>
+      void run_each_caller(WORLD* w, TComponentView<ID_T, COMPS...>*)
       {
         (w);
-        if constexpr (SYS::compsNum > 0)
-          (*sysPtr_)( w->template view_get<typename SYS::template CompType<IS>...>() );
+        if constexpr (SYS::compsNum > 0 && SYS::lazyView)
+          (*sysPtr_)( w->template view_lazy<COMPS...>() );
+        else if constexpr (SYS::compsNum > 0)
+          (*sysPtr_)( w->template view_get<COMPS...>() );
         else
           (*sysPtr_)();
       }
 
-      void run(TWorld<ID_T>* w) override
+      void run(WORLD* w) override
+      {
+        run_each_caller(w, static_cast<typename SYS::ComponentView*>(nullptr));
+      }
+
+      void bind(WORLD& w) override
       {
-        run_each_caller(w, std::make_index_sequence<SYS::compsNum>());
+        sysPtr_->bind_resources(w);
       }
     };
 
     std::unique_ptr<Base> bPtr_ = nullptr;
+    /// Set for `tickEnd` systems that may be pipelined, see `SYS::readOnly`.
+    bool                  readOnly_ = false;
   };
 
 
 
-  template <typename COMP, typename ID_T>
-  TCompArray<COMP, ID_T>::TCompArray()
-  {}
+  // TEntitySet ////////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  inline ID_T* TEntitySet<ID_T>::map_slot(ID_T id)
+  {
+    size_t const i = static_cast<size_t>(id);
+    if (storage_ == CompStorage::sparse)
+    {
+      size_t const page = i / pageSize;
+      if (map_.size() <= page || !map_[page].slots)
+        return nullptr;
+      return &map_[page].slots[i % pageSize];
+    }
+    if (storage_ == CompStorage::dense)
+      return i < flat_.size() ? &flat_[i] : nullptr;
+    return hash_slot(id);
+  }
 
-  // TCompArray ////////////////////////////////////////////////////////////////
-  template<typename COMP, typename ID_T>
-  template<typename ...ARGS>
-  bool TCompArray<COMP, ID_T>::insert(ID_T id, ARGS&&... args)
+  template<typename ID_T>
+  ID_T* TEntitySet<ID_T>::hash_slot(ID_T id)
   {
-    // Check if the id is already added to the array
-    if (map_.size() > id && map_[id] != std::numeric_limits<ID_T>::max())
-      return false;
-    
-    // Otherwise, insert it
-    try
+    auto it = hash_.find(id);
+    return it != hash_.end() ? &it->second : nullptr;
+  }
+
+  template<typename ID_T>
+  typename TEntitySet<ID_T>::Page& TEntitySet<ID_T>::map_page(size_t page)
+  {
+    if (map_.size() <= page)
+      map_.resize(page + 1);
+
+    Page& p = map_[page];
+    if (!p.slots)
     {
-      arr_.push_back(COMP{ std::forward<ARGS>(args)... });
+      p.slots.reset(new ID_T[pageSize]);
+      std::fill_n(p.slots.get(), pageSize, std::numeric_limits<ID_T>::max());
     }
-    catch (std::exception ex)
+    return p;
+  }
+
+  template<typename ID_T>
+  size_t TEntitySet<ID_T>::set_insert(ID_T id)
+  {
+    size_t const index = revMap_.size();
+    size_t const i = static_cast<size_t>(id);
+
+    // Check if the id is already added to the set
+    switch (storage_)
     {
-      printf(ex.what());
+    case CompStorage::dense:
+      if (flat_.size() <= i)
+        flat_.resize(i + 1, std::numeric_limits<ID_T>::max());
+      if (flat_[i] != std::numeric_limits<ID_T>::max())
+        return std::numeric_limits<size_t>::max();
+      flat_[i] = static_cast<ID_T>(index);
+      break;
+    case CompStorage::hashed:
+      if (!hash_.try_emplace(id, static_cast<ID_T>(index)).second)
+        return std::numeric_limits<size_t>::max();
+      break;
+    default:
+    {
+      Page& p = map_page(i / pageSize);
+      ID_T& slot = p.slots[i % pageSize];
+      if (slot != std::numeric_limits<ID_T>::max())
+        return std::numeric_limits<size_t>::max();
+      slot = static_cast<ID_T>(index);
+      ++p.live;
+    }
     }
 
-    if (map_.size() <= id)
-      map_.resize(static_cast<size_t>(id + 1), std::numeric_limits<ID_T>::max());
-    map_[id] = static_cast<ID_T>(arr_.size() - 1);
+    ++version_;
+    idEnd_ = std::max(idEnd_, i + 1);
+    sorted_ = sorted_ && (revMap_.empty() || revMap_.back() < id);
     revMap_.push_back(id);
-    return true;
+    return index;
   }
 
-  template<typename COMP, typename ID_T>
-  void TCompArray<COMP, ID_T>::remove(ID_T id)
+  template<typename ID_T>
+  size_t TEntitySet<ID_T>::set_insert_range(ID_T first, ID_T count)
   {
-    if (map_.size() <= id || map_[id] == std::numeric_limits<ID_T>::max())
-      return;
-    size_t index = map_[id];
+    size_t const start = revMap_.size();
+    if (count == 0)
+      return start;
 
-    arr_[index] = arr_.back();
-    revMap_[index] = revMap_.back();
+    size_t const begin = static_cast<size_t>(first);
+    size_t const end = begin + count;
 
+    sorted_ = sorted_ && (revMap_.empty() || revMap_.back() < first);
+    ++version_;
+    idEnd_ = std::max(idEnd_, end);
+    revMap_.resize(start + count);
+    std::iota(revMap_.begin() + start, revMap_.end(), first);
 
+    switch (storage_)
+    {
+    case CompStorage::dense:
+      if (flat_.size() < end)
+        flat_.resize(end, std::numeric_limits<ID_T>::max());
+      std::iota(flat_.begin() + begin, flat_.begin() + end, static_cast<ID_T>(start));
+      break;
+    case CompStorage::hashed:
+      hash_.reserve(hash_.size() + count);
+      for (size_t k = 0; k < count; ++k)
+        hash_.emplace(static_cast<ID_T>(begin + k), static_cast<ID_T>(start + k));
+      break;
+    default:
+    {
+      size_t index = start;
+      for (size_t id = begin; id < end;)
+      {
+        Page& p = map_page(id / pageSize);
+        size_t const offset = id % pageSize;
+        size_t const n = std::min(pageSize - offset, end - id);
+        ID_T* slots = p.slots.get() + offset;
+        for (size_t k = 0; k < n; ++k)
+          slots[k] = static_cast<ID_T>(index + k);
 
-    arr_.pop_back();
+        p.live += n;
+        index += n;
+        id += n;
+      }
+    }
+    }
+    return start;
+  }
+
+  template<typename ID_T>
+  size_t TEntitySet<ID_T>::set_remove(ID_T id)
+  {
+    ID_T* slot = map_slot(id);
+    if (!slot || *slot == std::numeric_limits<ID_T>::max())
+      return std::numeric_limits<size_t>::max();
+    size_t index = *slot;
+
+    ID_T moved = revMap_.back();
+    revMap_[index] = moved;
     revMap_.pop_back();
-    map_[id] = std::numeric_limits<ID_T>::max();
+    ++version_;
+    if (storage_ == CompStorage::hashed)
+      hash_.erase(id);
+    else
+    {
+      *slot = std::numeric_limits<ID_T>::max();
+      if (storage_ == CompStorage::sparse)
+        --map_[static_cast<size_t>(id) / pageSize].live;
+    }
+    if (moved != id)
+    {
+      *map_slot(moved) = static_cast<ID_T>(index);
+      sorted_ = false;
+    }
+    return index;
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::set_swap(size_t i, size_t j)
+  {
+    std::swap(revMap_[i], revMap_[j]);
+    *map_slot(revMap_[i]) = static_cast<ID_T>(i);
+    *map_slot(revMap_[j]) = static_cast<ID_T>(j);
+    ++version_;
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::set_assign(TEntitySet const& other)
+  {
+    map_.resize(other.map_.size());
+    for (size_t p = 0; p < map_.size(); ++p)
+    {
+      Page const& src = other.map_[p];
+      if (!src.slots)
+      {
+        map_[p] = Page{};
+        continue;
+      }
+      if (!map_[p].slots)
+        map_[p].slots.reset(new ID_T[pageSize]);
+      std::copy_n(src.slots.get(), pageSize, map_[p].slots.get());
+      map_[p].live = src.live;
+    }
+    flat_ = other.flat_;
+    hash_ = other.hash_;
+    revMap_ = other.revMap_;
+    idEnd_ = other.idEnd_;
+    storage_ = other.storage_;
+    sorted_ = other.sorted_;
+    keepSorted_ = other.keepSorted_;
+    defragIds_.clear();
+    defragPos_ = 0;
+    ++version_;
+  }
+
+  template<typename ID_T>
+  std::vector<size_t> TEntitySet<ID_T>::sorted_order() const
+  {
+    std::vector<size_t> order(revMap_.size());
+    std::iota(order.begin(), order.end(), size_t{ 0 });
+    std::sort(order.begin(), order.end(), [this](size_t l, size_t r)
+    {
+      return revMap_[l] < revMap_[r];
+    });
+    return order;
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::apply_order(std::vector<size_t> const& order)
+  {
+    std::vector<ID_T> ids(revMap_.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+      ids[i] = revMap_[order[i]];
+      *map_slot(ids[i]) = static_cast<ID_T>(i);
+    }
+    revMap_.swap(ids);
+    sorted_ = std::is_sorted(revMap_.begin(), revMap_.end());
+    ++version_;
+  }
+
+  template<typename ID_T>
+  ID_T TEntitySet<ID_T>::get_id(size_t index)
+  {
+    return revMap_[index];
+  }
+
+  template<typename ID_T>
+  TArrayView<ID_T> TEntitySet<ID_T>::ids()
+  {
+    return TArrayView<ID_T>{revMap_.data(), revMap_.size()};
+  }
+
+  template<typename ID_T>
+  bool TEntitySet<ID_T>::contains(ID_T id)
+  {
+    ID_T* slot = map_slot(id);
+    return slot && *slot != std::numeric_limits<ID_T>::max();
+  }
+
+  template<typename ID_T>
+  size_t TEntitySet<ID_T>::index_of(ID_T ent)
+  {
+    ID_T* slot = map_slot(ent);
+    if (!slot || *slot == std::numeric_limits<ID_T>::max())
+      return std::numeric_limits<size_t>::max();
+    return *slot;
+  }
+
+  template<typename ID_T>
+  size_t TEntitySet<ID_T>::size() const
+  {
+    return revMap_.size();
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::prefetch_id(ID_T id)
+  {
+    size_t const i = static_cast<size_t>(id);
+    if (storage_ == CompStorage::dense)
+    {
+      if (i < flat_.size())
+        ECS_PREFETCH(&flat_[i]);
+    }
+    else if (storage_ == CompStorage::sparse)
+    {
+      size_t const page = i / pageSize;
+      if (page < map_.size() && map_[page].slots)
+        ECS_PREFETCH(&map_[page].slots[i % pageSize]);
+    }
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::prefetch_ids(ID_T const* ids, size_t count)
+  {
+    if (storage_ == CompStorage::sparse)
+    {
+      for (size_t k = 0; k < count; ++k)
+      {
+        size_t const page = static_cast<size_t>(ids[k]) / pageSize;
+        if (page < map_.size() && map_[page].slots)
+          ECS_PREFETCH(&map_[page].slots[static_cast<size_t>(ids[k]) % pageSize]);
+      }
+    }
+    else if (storage_ == CompStorage::dense)
+    {
+      for (size_t k = 0; k < count; ++k)
+      {
+        if (static_cast<size_t>(ids[k]) < flat_.size())
+          ECS_PREFETCH(&flat_[static_cast<size_t>(ids[k])]);
+      }
+    }
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::index_of_batch(ID_T const* ids, size_t count, size_t* out, size_t stride)
+  {
+    constexpr ID_T absent = std::numeric_limits<ID_T>::max();
+    constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    switch (storage_)
+    {
+    case CompStorage::dense:
+    {
+      ID_T const* flat = flat_.data();
+      size_t const size = flat_.size();
+      for (size_t k = 0; k < count; ++k)
+      {
+        size_t const i = static_cast<size_t>(ids[k]);
+        ID_T const slot = i < size ? flat[i] : absent;
+        out[k * stride] = slot == absent ? npos : slot;
+      }
+      break;
+    }
+    case CompStorage::hashed:
+      for (size_t k = 0; k < count; ++k)
+        out[k * stride] = index_of(ids[k]);
+      break;
+    default:
+      for (size_t k = 0; k < count; ++k)
+      {
+        size_t const i = static_cast<size_t>(ids[k]);
+        size_t const page = i / pageSize;
+        ID_T const slot = page < map_.size() && map_[page].slots ? map_[page].slots[i % pageSize] : absent;
+        out[k * stride] = slot == absent ? npos : slot;
+      }
+    }
+  }
+
+  template<typename ID_T>
+  CompMemoryStats TEntitySet<ID_T>::memory_stats()
+  {
+    CompMemoryStats stats;
+    stats.count = revMap_.size();
+    stats.storage = storage_;
+    stats.suggested = suggest_storage();
+    stats.revMapBytes = revMap_.capacity() * sizeof(ID_T);
+    stats.unusedBytes = (revMap_.capacity() - revMap_.size()) * sizeof(ID_T);
+
+    switch (storage_)
+    {
+    case CompStorage::dense:
+      stats.mapBytes = flat_.capacity() * sizeof(ID_T);
+      if (!flat_.empty())
+        stats.mapFill = static_cast<float>(stats.count) / static_cast<float>(flat_.size());
+      stats.unusedBytes += (flat_.capacity() - flat_.size()) * sizeof(ID_T);
+      break;
+    case CompStorage::hashed:
+      // Approximate: every node holds the pair and a link, and every bucket
+      // a pointer.
+      stats.mapBytes = hash_.bucket_count() * sizeof(void*)
+                     + hash_.size() * (sizeof(std::pair<ID_T const, ID_T>) + sizeof(void*));
+      if (!hash_.empty())
+        stats.mapFill = 1.f;
+      break;
+    default:
+      stats.mapBytes = map_.capacity() * sizeof(Page);
+      for (Page const& p : map_)
+      {
+        if (!p.slots)
+          continue;
+        ++stats.mapPages;
+        if (p.live == 0)
+          ++stats.mapEmptyPages;
+      }
+      stats.mapBytes += stats.mapPages * pageSize * sizeof(ID_T);
+      if (stats.mapPages)
+        stats.mapFill = static_cast<float>(stats.count) / static_cast<float>(stats.mapPages * pageSize);
+      stats.unusedBytes += stats.mapEmptyPages * pageSize * sizeof(ID_T);
+    }
+    return stats;
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::shrink()
+  {
+    // The high-water mark only grows while ids are added, bring it back down
+    // to the highest id still present.
+    idEnd_ = revMap_.empty() ? 0 : static_cast<size_t>(*std::max_element(revMap_.begin(), revMap_.end())) + 1;
 
-    if(index >= revMap_.size())
+    switch (storage_)
     {
+    case CompStorage::dense:
+      flat_.resize(idEnd_);
+      flat_.shrink_to_fit();
+      break;
+    case CompStorage::hashed:
+      hash_.rehash(0);
+      break;
+    default:
+      for (Page& p : map_)
+      {
+        if (p.live == 0)
+          p.slots.reset();
+      }
+      while (!map_.empty() && !map_.back().slots)
+        map_.pop_back();
+      map_.shrink_to_fit();
+    }
+    revMap_.shrink_to_fit();
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::clear()
+  {
+    switch (storage_)
+    {
+    case CompStorage::dense:
+      for (ID_T id : revMap_)
+        flat_[static_cast<size_t>(id)] = std::numeric_limits<ID_T>::max();
+      break;
+    case CompStorage::hashed:
+      hash_.clear();
+      break;
+    default:
+      for (ID_T id : revMap_)
+      {
+        *map_slot(id) = std::numeric_limits<ID_T>::max();
+        --map_[static_cast<size_t>(id) / pageSize].live;
+      }
+    }
+    revMap_.clear();
+    idEnd_ = 0;
+    sorted_ = true;
+    ++version_;
+  }
+
+  template<typename ID_T>
+  void TEntitySet<ID_T>::set_storage(CompStorage storage)
+  {
+    if (storage == storage_)
       return;
+
+    // Drop the old mapping entirely and rebuild it from the dense ids.
+    std::vector<Page>().swap(map_);
+    std::vector<ID_T>().swap(flat_);
+    std::unordered_map<ID_T, ID_T>().swap(hash_);
+    storage_ = storage;
+
+    switch (storage_)
+    {
+    case CompStorage::dense:
+      flat_.assign(idEnd_, std::numeric_limits<ID_T>::max());
+      for (size_t i = 0; i < revMap_.size(); ++i)
+        flat_[static_cast<size_t>(revMap_[i])] = static_cast<ID_T>(i);
+      break;
+    case CompStorage::hashed:
+      hash_.reserve(revMap_.size());
+      for (size_t i = 0; i < revMap_.size(); ++i)
+        hash_.emplace(revMap_[i], static_cast<ID_T>(i));
+      break;
+    default:
+      for (size_t i = 0; i < revMap_.size(); ++i)
+      {
+        size_t const id = static_cast<size_t>(revMap_[i]);
+        Page& p = map_page(id / pageSize);
+        p.slots[id % pageSize] = static_cast<ID_T>(i);
+        ++p.live;
+      }
+    }
+  }
+
+  template<typename ID_T>
+  CompStorage TEntitySet<ID_T>::suggest_storage() const
+  {
+    size_t const count = revMap_.size();
+    if (count == 0)
+      return storage_;
+
+    // Dense is entered once half of the ids up to the highest one are present
+    // and left below a quarter. Hashed is entered below 1/64 and left above
+    // 1/16.
+    if (storage_ == CompStorage::dense && count * 4 >= idEnd_)
+      return CompStorage::dense;
+    if (storage_ == CompStorage::hashed && count * 16 <= idEnd_)
+      return CompStorage::hashed;
+    if (count * 2 >= idEnd_)
+      return CompStorage::dense;
+    if (count * 64 <= idEnd_)
+      return CompStorage::hashed;
+    return CompStorage::sparse;
+  }
+
+  template<typename ID_T>
+  bool TEntitySet<ID_T>::defrag_step(size_t count)
+  {
+    if (sorted_)
+    {
+      std::vector<ID_T>().swap(defragIds_);
+      defragPos_ = 0;
+      return true;
     }
 
-    if(revMap_.size() > 0 && revMap_[index] != std::numeric_limits<ID_T>::max())
+    // A pass places the ids in the order taken when it started. If others
+    // changed the set since the last step, the order is taken again; entries
+    // already in place are walked past without a swap.
+    if (defragIds_.empty() || defragVersion_ != version_)
     {
-      map_[revMap_[index]] = static_cast<ID_T>(index);
+      std::vector<size_t> const order = sorted_order();
+      defragIds_.resize(order.size());
+      for (size_t i = 0; i < order.size(); ++i)
+        defragIds_[i] = revMap_[order[i]];
+      defragPos_ = 0;
     }
+
+    for (; count > 0 && defragPos_ < defragIds_.size(); ++defragPos_)
+    {
+      size_t const j = index_of(defragIds_[defragPos_]);
+      if (j == defragPos_)
+        continue;
+      this->swap_entries(defragPos_, j);
+      --count;
+    }
+    defragVersion_ = version_;
+    if (defragPos_ < defragIds_.size())
+      return false;
+
+    sorted_ = true;
+    std::vector<ID_T>().swap(defragIds_);
+    defragPos_ = 0;
+    return true;
   }
 
-  template<typename COMP, typename ID_T>
-  COMP* TCompArray<COMP, ID_T>::get(ID_T id)
+  template<typename ID_T>
+  bool TEntitySet<ID_T>::adapt_storage()
+  {
+    if (storagePinned_)
+      return false;
+    CompStorage const storage = suggest_storage();
+    if (storage == storage_)
+      return false;
+    set_storage(storage);
+    return true;
+  }
+
+  // TCompArray ////////////////////////////////////////////////////////////////
+  template <typename COMP, typename ID_T, CompLayout LAYOUT>
+  TCompArray<COMP, ID_T, LAYOUT>::TCompArray()
+    : TEntitySet<ID_T>{ CompStorageOf<COMP>::value, CompStorageOf<COMP>::declared }
+  {}
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  template<typename ...ARGS>
+  bool TCompArray<COMP, ID_T, LAYOUT>::insert(ID_T id, ARGS&&... args)
+  {
+    if (this->contains(id))
+      return false;
+
+    // Construct the component before touching the set so a throwing
+    // constructor leaves the array untouched. Aggregates can not be
+    // constructed with parentheses in C++17, so those are built with braces
+    // and moved in.
+    if constexpr (std::is_constructible_v<COMP, ARGS&&...>)
+      arr_.emplace_back(std::forward<ARGS>(args)...);
+    else
+      arr_.push_back(COMP{ std::forward<ARGS>(args)... });
+
+    this->set_insert(id);
+    return true;
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::remove(ID_T id)
+  {
+    size_t index = this->set_remove(id);
+    if (index == std::numeric_limits<size_t>::max())
+      return;
+
+    if (index != arr_.size() - 1)
+    {
+      // Byte-swapping leaves the removed component at the back, where
+      // pop_back destroys it. Trivially copyable types are simply assigned.
+      if constexpr (comp_relocatable_v<COMP> && !std::is_trivially_copyable_v<COMP>)
+        relocate_swap(arr_[index], arr_.back());
+      else
+        arr_[index] = std::move(arr_.back());
+    }
+    arr_.pop_back();
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  COMP* TCompArray<COMP, ID_T, LAYOUT>::get(ID_T id)
   {
-    if (map_.size() <= id || map_[id] == std::numeric_limits<ID_T>::max() || arr_.size() <= map_[id])
+    size_t index = this->index_of(id);
+    if (index >= arr_.size())
       return nullptr;
-    return &(arr_[map_[id]]);
+    return &(arr_[index]);
   }
 
-  template<typename COMP, typename ID_T>
-  COMP* TCompArray<COMP, ID_T>::get_by_index(size_t i)
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  COMP* TCompArray<COMP, ID_T, LAYOUT>::get_by_index(size_t i)
   {
     if (i >= arr_.size())
       return nullptr;
     return &(arr_[i]);
   }
 
-  template<typename COMP, typename ID_T>
-  ID_T TCompArray<COMP, ID_T>::get_id(size_t index)
-  {
-    return revMap_[index];
-  }
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::prefetch_index(size_t i)
+  {
+    if (i < arr_.size())
+      ECS_PREFETCH(arr_.data() + i);
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  ID_T TCompArray<COMP, ID_T, LAYOUT>::get_id(COMP& comp)
+  {
+    return this->revMap_[&comp - arr_.data()];
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  std::vector<COMP>& TCompArray<COMP, ID_T, LAYOUT>::array()
+  {
+    return arr_;
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::sort_by_id()
+  {
+    if (this->is_sorted())
+      return;
+    std::vector<size_t> order = this->sorted_order();
+
+    if constexpr (comp_relocatable_v<COMP>)
+    {
+      // Apply the permutation in place by following its cycles.
+      std::vector<bool> done(order.size());
+      for (size_t start = 0; start < order.size(); ++start)
+      {
+        if (done[start])
+          continue;
+        size_t i = start;
+        while (order[i] != start)
+        {
+          relocate_swap(arr_[i], arr_[order[i]]);
+          done[i] = true;
+          i = order[i];
+        }
+        done[i] = true;
+      }
+    }
+    else
+    {
+      std::vector<COMP> sorted;
+      sorted.reserve(arr_.size());
+      for (size_t i : order)
+        sorted.push_back(std::move(arr_[i]));
+      arr_.swap(sorted);
+    }
+    this->apply_order(order);
+  }
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::swap_entries(size_t i, size_t j)
+  {
+    this->set_swap(i, j);
+    if constexpr (comp_relocatable_v<COMP>)
+      relocate_swap(arr_[i], arr_[j]);
+    else
+    {
+      using std::swap;
+      swap(arr_[i], arr_[j]);
+    }
+  }
+
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  CompMemoryStats TCompArray<COMP, ID_T, LAYOUT>::memory_stats()
+  {
+    CompMemoryStats stats = TEntitySet<ID_T>::memory_stats();
+    stats.typeName = type_name<COMP>();
+    stats.capacity = arr_.capacity();
+    stats.denseBytes = arr_.capacity() * sizeof(COMP);
+    stats.unusedBytes += (arr_.capacity() - arr_.size()) * sizeof(COMP);
+    return stats;
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::shrink()
+  {
+    TEntitySet<ID_T>::shrink();
+    arr_.shrink_to_fit();
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::clear()
+  {
+    TEntitySet<ID_T>::clear();
+    arr_.clear();
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::merge_from(ICompArrayBase<ID_T>& other)
+  {
+    // Arrays are only merged between registries, where the type id
+    // guarantees a matching type.
+    auto& src = static_cast<TCompArray&>(other);
+    arr_.reserve(arr_.size() + src.arr_.size());
+    this->revMap_.reserve(this->revMap_.size() + src.size());
+
+    for (size_t i = 0; i < src.arr_.size(); ++i)
+    {
+      ID_T id = src.get_id(i);
+      if (this->contains(id))
+        continue;
+      arr_.push_back(std::move(src.arr_[i]));
+      this->set_insert(id);
+    }
+    src.clear();
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  std::unique_ptr<ICompArrayBase<ID_T>> TCompArray<COMP, ID_T, LAYOUT>::make_empty()
+  {
+    return std::make_unique<TCompArray>();
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId)
+  {
+    if constexpr (std::is_copy_constructible_v<COMP>)
+    {
+      COMP* comp = get(id);
+      if (comp)
+        static_cast<TCompArray&>(dst).insert(dstId, *comp);
+    }
+    else
+    {
+      (id); (dst); (dstId);
+      throw std::runtime_error{ "Component type is not copyable!" };
+    }
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count)
+  {
+    if constexpr (std::is_copy_constructible_v<COMP>)
+    {
+      auto& src = static_cast<TCompArray&>(proto);
+      size_t const index = src.index_of(protoId);
+      if (index == std::numeric_limits<size_t>::max() || count == 0)
+        return;
+
+      // A single fill insert; trivially copyable components are block copied.
+      arr_.insert(arr_.end(), count, src.arr_[index]);
+      this->set_insert_range(first, count);
+    }
+    else
+    {
+      (proto); (protoId); (first); (count);
+      throw std::runtime_error{ "Component type is not copyable!" };
+    }
+  }
+
+  template<typename COMP, typename ID_T, CompLayout LAYOUT>
+  void TCompArray<COMP, ID_T, LAYOUT>::assign_from(ICompArrayBase<ID_T>& other)
+  {
+    if constexpr (std::is_copy_constructible_v<COMP> && std::is_copy_assignable_v<COMP>)
+    {
+      TCompArray& src = static_cast<TCompArray&>(other);
+      this->set_assign(src);
+      arr_ = src.arr_;
+    }
+    else
+    {
+      (other);
+      throw std::runtime_error{ "Component type is not copyable!" };
+    }
+  }
+
+  // TCompArray (tag) //////////////////////////////////////////////////////////
+  template<typename COMP, typename ID_T>
+  template<typename ...ARGS>
+  bool TCompArray<COMP, ID_T, CompLayout::tag>::insert(ID_T id, ARGS&&...)
+  {
+    return this->set_insert(id) != std::numeric_limits<size_t>::max();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::remove(ID_T id)
+  {
+    this->set_remove(id);
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP* TCompArray<COMP, ID_T, CompLayout::tag>::get(ID_T id)
+  {
+    return this->contains(id) ? &instance_ : nullptr;
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP* TCompArray<COMP, ID_T, CompLayout::tag>::get_by_index(size_t i)
+  {
+    return i < this->size() ? &instance_ : nullptr;
+  }
+
+  template<typename COMP, typename ID_T>
+  ID_T TCompArray<COMP, ID_T, CompLayout::tag>::get_id(COMP& comp)
+  {
+    (comp);
+    return std::numeric_limits<ID_T>::max();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::sort_by_id()
+  {
+    if (!this->is_sorted())
+      this->apply_order(this->sorted_order());
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::swap_entries(size_t i, size_t j)
+  {
+    this->set_swap(i, j);
+  }
+
+  template<typename COMP, typename ID_T>
+  CompMemoryStats TCompArray<COMP, ID_T, CompLayout::tag>::memory_stats()
+  {
+    CompMemoryStats stats = TEntitySet<ID_T>::memory_stats();
+    stats.typeName = type_name<COMP>();
+    stats.capacity = this->revMap_.capacity();
+    return stats;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::merge_from(ICompArrayBase<ID_T>& other)
+  {
+    auto& src = static_cast<TCompArray&>(other);
+    this->revMap_.reserve(this->revMap_.size() + src.size());
+    for (ID_T id : src.ids())
+      this->set_insert(id);
+    src.clear();
+  }
+
+  template<typename COMP, typename ID_T>
+  std::unique_ptr<ICompArrayBase<ID_T>> TCompArray<COMP, ID_T, CompLayout::tag>::make_empty()
+  {
+    return std::make_unique<TCompArray>();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId)
+  {
+    if (this->contains(id))
+      static_cast<TCompArray&>(dst).insert(dstId);
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count)
+  {
+    if (proto.contains(protoId))
+      this->set_insert_range(first, count);
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::tag>::assign_from(ICompArrayBase<ID_T>& other)
+  {
+    this->set_assign(static_cast<TCompArray&>(other));
+  }
+
+
+
+  // TCompArray (stable) ///////////////////////////////////////////////////////
+  template<typename COMP, typename ID_T>
+  TCompArray<COMP, ID_T, CompLayout::stable>::~TCompArray()
+  {
+    clear();
+  }
+
+  template<typename COMP, typename ID_T>
+  typename TCompArray<COMP, ID_T, CompLayout::stable>::Slot*
+  TCompArray<COMP, ID_T, CompLayout::stable>::acquire_slot()
+  {
+    if (free_.empty())
+    {
+      // Reuse the entry of a released page so page numbers stay valid.
+      size_t page = 0;
+      while (page < pages_.size() && pages_[page].slots)
+        ++page;
+      if (page == pages_.size())
+        pages_.emplace_back();
+
+      SlotPage& p = pages_[page];
+      p.slots.reset(new Slot[slotsPerPage]);
+      // Pushed in reverse so the lowest slot is handed out first.
+      for (size_t i = slotsPerPage; i-- > 0;)
+      {
+        p.slots[i].page = static_cast<uint32_t>(page);
+        free_.push_back(&p.slots[i]);
+      }
+    }
+
+    Slot* slot = free_.back();
+    free_.pop_back();
+    return slot;
+  }
+
+  template<typename COMP, typename ID_T>
+  template<typename ...ARGS>
+  bool TCompArray<COMP, ID_T, CompLayout::stable>::insert(ID_T id, ARGS&&... args)
+  {
+    if (this->contains(id))
+      return false;
+
+    Slot* slot = acquire_slot();
+    try
+    {
+      if constexpr (std::is_constructible_v<COMP, ARGS&&...>)
+        new (slot->data) COMP(std::forward<ARGS>(args)...);
+      else
+        new (slot->data) COMP{ std::forward<ARGS>(args)... };
+    }
+    catch (...)
+    {
+      free_.push_back(slot);
+      throw;
+    }
+
+    slot->owner = id;
+    ++pages_[slot->page].live;
+    ptrs_.push_back(slot);
+    this->set_insert(id);
+    return true;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::remove(ID_T id)
+  {
+    size_t index = this->set_remove(id);
+    if (index == std::numeric_limits<size_t>::max())
+      return;
+
+    // Only the pointer list is compacted, the component itself never moves.
+    Slot* slot = ptrs_[index];
+    ptrs_[index] = ptrs_.back();
+    ptrs_.pop_back();
+
+    slot->comp()->~COMP();
+    slot->owner = std::numeric_limits<ID_T>::max();
+    --pages_[slot->page].live;
+    free_.push_back(slot);
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP* TCompArray<COMP, ID_T, CompLayout::stable>::get(ID_T id)
+  {
+    return get_by_index(this->index_of(id));
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP* TCompArray<COMP, ID_T, CompLayout::stable>::get_by_index(size_t i)
+  {
+    if (i >= ptrs_.size())
+      return nullptr;
+    return ptrs_[i]->comp();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::prefetch_index(size_t i)
+  {
+    if (i < ptrs_.size())
+      ECS_PREFETCH(ptrs_[i]);
+  }
+
+  template<typename COMP, typename ID_T>
+  ID_T TCompArray<COMP, ID_T, CompLayout::stable>::get_id(COMP& comp)
+  {
+    // Components are stored at the start of their slot.
+    return reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(&comp))->owner;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::sort_by_id()
+  {
+    if (this->is_sorted())
+      return;
+    std::vector<size_t> order = this->sorted_order();
+
+    std::vector<Slot*> sorted;
+    sorted.reserve(ptrs_.size());
+    for (size_t i : order)
+      sorted.push_back(ptrs_[i]);
+    ptrs_.swap(sorted);
+    this->apply_order(order);
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::swap_entries(size_t i, size_t j)
+  {
+    this->set_swap(i, j);
+    std::swap(ptrs_[i], ptrs_[j]);
+  }
+
+  template<typename COMP, typename ID_T>
+  CompMemoryStats TCompArray<COMP, ID_T, CompLayout::stable>::memory_stats()
+  {
+    CompMemoryStats stats = TEntitySet<ID_T>::memory_stats();
+    stats.typeName = type_name<COMP>();
+    for (SlotPage const& p : pages_)
+    {
+      if (p.slots)
+        stats.capacity += slotsPerPage;
+    }
+    stats.denseBytes = stats.capacity * sizeof(Slot)
+                     + ptrs_.capacity() * sizeof(Slot*)
+                     + free_.capacity() * sizeof(Slot*)
+                     + pages_.capacity() * sizeof(SlotPage);
+    stats.unusedBytes += (stats.capacity - ptrs_.size()) * sizeof(Slot)
+                       + (ptrs_.capacity() - ptrs_.size()) * sizeof(Slot*);
+    return stats;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::shrink()
+  {
+    TEntitySet<ID_T>::shrink();
+
+    for (SlotPage& p : pages_)
+    {
+      if (p.slots && p.live == 0)
+        p.slots.reset();
+    }
+    while (!pages_.empty() && !pages_.back().slots)
+      pages_.pop_back();
+
+    // Released pages may have had slots on the free list.
+    free_.clear();
+    for (SlotPage& p : pages_)
+    {
+      if (!p.slots)
+        continue;
+      for (size_t i = slotsPerPage; i-- > 0;)
+      {
+        if (p.slots[i].owner == std::numeric_limits<ID_T>::max())
+          free_.push_back(&p.slots[i]);
+      }
+    }
+
+    pages_.shrink_to_fit();
+    free_.shrink_to_fit();
+    ptrs_.shrink_to_fit();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::clear()
+  {
+    for (Slot* slot : ptrs_)
+    {
+      slot->comp()->~COMP();
+      slot->owner = std::numeric_limits<ID_T>::max();
+      --pages_[slot->page].live;
+      free_.push_back(slot);
+    }
+    ptrs_.clear();
+    TEntitySet<ID_T>::clear();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::merge_from(ICompArrayBase<ID_T>& other)
+  {
+    auto& src = static_cast<TCompArray&>(other);
+    ptrs_.reserve(ptrs_.size() + src.size());
+    for (size_t i = 0; i < src.ptrs_.size(); ++i)
+      insert(src.get_id(i), std::move(*src.ptrs_[i]->comp()));
+    src.clear();
+  }
+
+  template<typename COMP, typename ID_T>
+  std::unique_ptr<ICompArrayBase<ID_T>> TCompArray<COMP, ID_T, CompLayout::stable>::make_empty()
+  {
+    return std::make_unique<TCompArray>();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId)
+  {
+    if constexpr (std::is_copy_constructible_v<COMP>)
+    {
+      COMP* comp = get(id);
+      if (comp)
+        static_cast<TCompArray&>(dst).insert(dstId, *comp);
+    }
+    else
+    {
+      (id); (dst); (dstId);
+      throw std::runtime_error{ "Component type is not copyable!" };
+    }
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count)
+  {
+    if constexpr (std::is_copy_constructible_v<COMP>)
+    {
+      auto& src = static_cast<TCompArray&>(proto);
+      size_t const index = src.index_of(protoId);
+      if (index == std::numeric_limits<size_t>::max() || count == 0)
+        return;
+
+      COMP const& value = *src.ptrs_[index]->comp();
+      size_t const start = ptrs_.size();
+      ptrs_.reserve(start + count);
+      try
+      {
+        for (ID_T i = 0; i < count; ++i)
+        {
+          Slot* slot = acquire_slot();
+          try
+          {
+            new (slot->data) COMP(value);
+          }
+          catch (...)
+          {
+            free_.push_back(slot);
+            throw;
+          }
+          slot->owner = first + i;
+          ++pages_[slot->page].live;
+          ptrs_.push_back(slot);
+        }
+      }
+      catch (...)
+      {
+        // Roll back the copies made so far so the set and slots stay in sync.
+        while (ptrs_.size() > start)
+        {
+          Slot* slot = ptrs_.back();
+          ptrs_.pop_back();
+          slot->comp()->~COMP();
+          slot->owner = std::numeric_limits<ID_T>::max();
+          --pages_[slot->page].live;
+          free_.push_back(slot);
+        }
+        throw;
+      }
+      this->set_insert_range(first, count);
+    }
+    else
+    {
+      (proto); (protoId); (first); (count);
+      throw std::runtime_error{ "Component type is not copyable!" };
+    }
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::stable>::assign_from(ICompArrayBase<ID_T>& other)
+  {
+    if constexpr (std::is_copy_constructible_v<COMP>)
+    {
+      // Slots can not be copied as a block, their addresses are the point.
+      TCompArray& src = static_cast<TCompArray&>(other);
+      clear();
+      for (size_t i = 0; i < src.size(); ++i)
+        insert(src.get_id(i), *src.ptrs_[i]->comp());
+    }
+    else
+    {
+      (other);
+      throw std::runtime_error{ "Component type is not copyable!" };
+    }
+  }
+
+
+
+  // TCompArray (buffered) /////////////////////////////////////////////////////
+  template<typename COMP, typename ID_T>
+  template<typename ...ARGS>
+  bool TCompArray<COMP, ID_T, CompLayout::buffered>::insert(ID_T id, ARGS&&... args)
+  {
+    if (this->contains(id))
+      return false;
+
+    if constexpr (std::is_constructible_v<COMP, ARGS&&...>)
+      write_.emplace_back(std::forward<ARGS>(args)...);
+    else
+      write_.push_back(COMP{ std::forward<ARGS>(args)... });
+    try
+    {
+      read_.push_back(write_.back());
+    }
+    catch (...)
+    {
+      write_.pop_back();
+      throw;
+    }
+
+    this->set_insert(id);
+    return true;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::remove(ID_T id)
+  {
+    size_t index = this->set_remove(id);
+    if (index == std::numeric_limits<size_t>::max())
+      return;
+
+    if (index != read_.size() - 1)
+    {
+      read_[index] = std::move(read_.back());
+      write_[index] = std::move(write_.back());
+    }
+    read_.pop_back();
+    write_.pop_back();
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP* TCompArray<COMP, ID_T, CompLayout::buffered>::get(ID_T id)
+  {
+    return get_by_index(this->index_of(id));
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP* TCompArray<COMP, ID_T, CompLayout::buffered>::get_by_index(size_t i)
+  {
+    if (i >= write_.size())
+      return nullptr;
+    begin_write();
+    return &write_[i];
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP const* TCompArray<COMP, ID_T, CompLayout::buffered>::read(ID_T id)
+  {
+    return read_by_index(this->index_of(id));
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP const* TCompArray<COMP, ID_T, CompLayout::buffered>::read_by_index(size_t i) const
+  {
+    return i < read_.size() ? &read_[i] : nullptr;
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP const* TCompArray<COMP, ID_T, CompLayout::buffered>::latest(ID_T id)
+  {
+    return latest_by_index(this->index_of(id));
+  }
+
+  template<typename COMP, typename ID_T>
+  COMP const* TCompArray<COMP, ID_T, CompLayout::buffered>::latest_by_index(size_t i) const
+  {
+    return i < read_.size() ? &current(i) : nullptr;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::prefetch_index(size_t i)
+  {
+    if (i < read_.size())
+    {
+      ECS_PREFETCH(read_.data() + i);
+      ECS_PREFETCH(write_.data() + i);
+    }
+  }
+
+  template<typename COMP, typename ID_T>
+  ID_T TCompArray<COMP, ID_T, CompLayout::buffered>::get_id(COMP const& comp)
+  {
+    for (std::vector<COMP> const* arr : { &write_, &read_ })
+    {
+      if (!arr->empty() && &comp >= arr->data() && &comp < arr->data() + arr->size())
+        return this->revMap_[&comp - arr->data()];
+    }
+    return std::numeric_limits<ID_T>::max();
+  }
+
+  template<typename COMP, typename ID_T>
+  std::vector<COMP>& TCompArray<COMP, ID_T, CompLayout::buffered>::array()
+  {
+    begin_write();
+    return write_;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::sort_by_id()
+  {
+    if (this->is_sorted())
+      return;
+    std::vector<size_t> order = this->sorted_order();
+    for (std::vector<COMP>* arr : { &read_, &write_ })
+    {
+      std::vector<COMP> sorted;
+      sorted.reserve(arr->size());
+      for (size_t i : order)
+        sorted.push_back(std::move((*arr)[i]));
+      arr->swap(sorted);
+    }
+    this->apply_order(order);
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::swap_entries(size_t i, size_t j)
+  {
+    this->set_swap(i, j);
+    std::swap(read_[i], read_[j]);
+    std::swap(write_[i], write_[j]);
+  }
+
+  template<typename COMP, typename ID_T>
+  CompMemoryStats TCompArray<COMP, ID_T, CompLayout::buffered>::memory_stats()
+  {
+    CompMemoryStats stats = TEntitySet<ID_T>::memory_stats();
+    stats.typeName = type_name<COMP>();
+    stats.capacity = read_.capacity();
+    stats.denseBytes = (read_.capacity() + write_.capacity()) * sizeof(COMP);
+    stats.unusedBytes += (read_.capacity() - read_.size() + write_.capacity() - write_.size()) * sizeof(COMP);
+    return stats;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::shrink()
+  {
+    TEntitySet<ID_T>::shrink();
+    read_.shrink_to_fit();
+    write_.shrink_to_fit();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::clear()
+  {
+    TEntitySet<ID_T>::clear();
+    read_.clear();
+    write_.clear();
+    synced_ = true;
+    written_ = false;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::merge_from(ICompArrayBase<ID_T>& other)
+  {
+    auto& src = static_cast<TCompArray&>(other);
+    read_.reserve(read_.size() + src.size());
+    write_.reserve(write_.size() + src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+      insert(src.get_id(i), std::move(src.current(i)));
+    src.clear();
+  }
+
+  template<typename COMP, typename ID_T>
+  std::unique_ptr<ICompArrayBase<ID_T>> TCompArray<COMP, ID_T, CompLayout::buffered>::make_empty()
+  {
+    return std::make_unique<TCompArray>();
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId)
+  {
+    size_t const index = this->index_of(id);
+    if (index != std::numeric_limits<size_t>::max())
+      static_cast<TCompArray&>(dst).insert(dstId, current(index));
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count)
+  {
+    auto& src = static_cast<TCompArray&>(proto);
+    size_t const index = src.index_of(protoId);
+    if (index == std::numeric_limits<size_t>::max() || count == 0)
+      return;
+
+    COMP const& value = src.current(index);
+    read_.insert(read_.end(), count, value);
+    write_.insert(write_.end(), count, value);
+    this->set_insert_range(first, count);
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::assign_from(ICompArrayBase<ID_T>& other)
+  {
+    TCompArray& src = static_cast<TCompArray&>(other);
+    this->set_assign(src);
+    read_ = src.read_;
+    write_ = src.write_;
+    synced_ = src.synced_;
+    written_ = src.written_;
+  }
+
+  template<typename COMP, typename ID_T>
+  void TCompArray<COMP, ID_T, CompLayout::buffered>::swap_buffers()
+  {
+    if (!written_)
+      return;
+    read_.swap(write_);
+    synced_ = false;
+    written_ = false;
+  }
+
+
+
+  // TCompRegistry /////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  template<typename COMP>
+  TCompArray<COMP, ID_T>& TCompRegistry<ID_T>::get_array()
+  {
+    size_t const key = get_type_id<COMP, ComponentFamily>();
+
+    if (reg_.size() <= key)
+    {
+      //reg_.emplace_back(new TCompArray<COMP, ID_T>{});
+      reg_.resize(key + 1);
+    }
+
+    if (reg_[key] == nullptr)
+    {
+      reg_[key].reset(new TCompArray<COMP, ID_T>{});
+    }
+
+    // The key is only ever given to arrays of COMP.
+    std::unique_ptr<ICompArrayBase<ID_T>>& arr = reg_[key];
+    return *static_cast<TCompArray<COMP, ID_T>*>(arr.get());
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::remove_all_of(ID_T id)
+  {
+    for (auto& arr : reg_)
+    {
+      if(!arr.get())
+      {
+        continue;
+      }
+      if (arr->contains(id))
+      {
+        arr->remove(id);
+      }
+    }
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::merge_from(TCompRegistry& other)
+  {
+    if (reg_.size() < other.reg_.size())
+      reg_.resize(other.reg_.size());
+
+    for (size_t i = 0; i < other.reg_.size(); ++i)
+    {
+      if (!other.reg_[i])
+        continue;
+      // Arrays not yet in use by this registry can be taken over whole.
+      if (!reg_[i])
+        reg_[i] = std::move(other.reg_[i]);
+      else
+        reg_[i]->merge_from(*other.reg_[i]);
+    }
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::copy_entity(ID_T id, TCompRegistry& dst, ID_T dstId)
+  {
+    if (dst.reg_.size() < reg_.size())
+      dst.reg_.resize(reg_.size());
+
+    for (size_t i = 0; i < reg_.size(); ++i)
+    {
+      if (!reg_[i] || !reg_[i]->contains(id))
+        continue;
+      if (!dst.reg_[i])
+        dst.reg_[i] = reg_[i]->make_empty();
+      reg_[i]->copy_to(id, *dst.reg_[i], dstId);
+    }
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::instantiate(TCompRegistry const& proto, ID_T protoId, ID_T first, ID_T count)
+  {
+    if (reg_.size() < proto.reg_.size())
+      reg_.resize(proto.reg_.size());
+
+    for (size_t i = 0; i < proto.reg_.size(); ++i)
+    {
+      if (!proto.reg_[i] || !proto.reg_[i]->contains(protoId))
+        continue;
+      if (!reg_[i])
+        reg_[i] = proto.reg_[i]->make_empty();
+      reg_[i]->fill_from(*proto.reg_[i], protoId, first, count);
+    }
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::assign_from(TCompRegistry& other, std::vector<uint32_t> const& keys)
+  {
+    for (uint32_t key : keys)
+    {
+      if (key >= other.reg_.size() || !other.reg_[key])
+        continue;
+      if (reg_.size() <= key)
+        reg_.resize(key + 1);
+      if (!reg_[key])
+        reg_[key] = other.reg_[key]->make_empty();
+      reg_[key]->assign_from(*other.reg_[key]);
+    }
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::swap_buffers()
+  {
+    for (auto& arr : reg_)
+    {
+      if (arr)
+        arr->swap_buffers();
+    }
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::sort_kept()
+  {
+    for (uint32_t key = 0; key < reg_.size(); ++key)
+    {
+      TEntitySet<ID_T>* set = find_set(key);
+      if (set && set->sort_mode() && !set->is_sorted())
+        set->sort_by_id();
+    }
+  }
+
+  template<typename ID_T>
+  bool TCompRegistry<ID_T>::defrag(size_t count)
+  {
+    TEntitySet<ID_T>* next = nullptr;
+    for (uint32_t key = 0; key < reg_.size(); ++key)
+    {
+      TEntitySet<ID_T>* set = find_set(key);
+      if (set && !set->is_sorted() && (!next || set->join_count() > next->join_count()))
+        next = set;
+    }
+    if (!next)
+      return false;
+
+    if (next->defrag_step(count))
+      next->shrink();
+    return true;
+  }
+
+  template<typename ID_T>
+  void TCompRegistry<ID_T>::adapt_storage()
+  {
+    for (auto& arr : reg_)
+    {
+      if (arr)
+        arr->adapt_storage();
+    }
+  }
+
+  template<typename ID_T>
+  TEntitySet<ID_T>* TCompRegistry<ID_T>::find_set(uint32_t key)
+  {
+    if (key >= reg_.size() || !reg_[key])
+      return nullptr;
+    // Every component array is an entity set.
+    return static_cast<TEntitySet<ID_T>*>(reg_[key].get());
+  }
+
+  template<typename ID_T>
+  std::vector<CompMemoryStats> TCompRegistry<ID_T>::memory_stats()
+  {
+    std::vector<CompMemoryStats> ret;
+    for (size_t i = 0; i < reg_.size(); ++i)
+    {
+      if (!reg_[i])
+        continue;
+      ret.push_back(reg_[i]->memory_stats());
+      ret.back().typeId = static_cast<uint32_t>(i);
+    }
+    return ret;
+  }
+
+  template<typename ID_T>
+  bool TCompRegistry<ID_T>::shrink(size_t& cursor, size_t count)
+  {
+    for (; cursor < reg_.size() && count > 0; ++cursor)
+    {
+      if (!reg_[cursor])
+        continue;
+      reg_[cursor]->shrink();
+      --count;
+    }
+
+    if (cursor < reg_.size())
+      return false;
+    cursor = 0;
+    return true;
+  }
+
+  // TResourceRegistry /////////////////////////////////////////////////////////
+  template<typename RES>
+  template<typename ...ARGS>
+  RES& TResource<RES>::emplace(ARGS&&... args)
+  {
+    ptr_.reset(new RES{ std::forward<ARGS>(args)... });
+    return *ptr_;
+  }
+
+  template<typename RES>
+  TResource<RES>& TResourceRegistry::get_slot()
+  {
+    size_t const key = get_type_id<RES, ResourceFamily>();
+
+    if (reg_.size() <= key)
+      reg_.resize(key + 1);
+
+    if (reg_[key] == nullptr)
+      reg_[key].reset(new TResource<RES>{});
+
+    // The key uniquely identifies the slot type, no need for a checked cast.
+    return *static_cast<TResource<RES>*>(reg_[key].get());
+  }
+
+  // PipelineDeps //////////////////////////////////////////////////////////////
+  template<typename ...COMP, typename ...RES>
+  void PipelineDeps::add(std::tuple<COMP...>*, std::tuple<RES...>*)
+  {
+    auto addComp = [this](uint32_t key)
+    {
+      if (std::find(comps.begin(), comps.end(), key) == comps.end())
+        comps.push_back(key);
+    };
+    auto addRes = [this](ResCopy copy)
+    {
+      for (ResCopy const& r : res)
+      {
+        if (r.key == copy.key)
+          return;
+      }
+      res.push_back(copy);
+    };
+    (addComp(get_type_id<std::remove_const_t<std::remove_pointer_t<COMP>>, ComponentFamily>()), ...);
+    (addRes(ResCopy{ get_type_id<RES, ResourceFamily>(), &copy_one<RES> }), ...);
+  }
+
+  template<typename RES>
+  void PipelineDeps::copy_one(TResourceRegistry& from, TResourceRegistry& to)
+  {
+    TResource<RES>& dst = to.get_slot<RES>();
+    RES const* src = from.get_slot<RES>().get();
+    if constexpr (std::is_copy_constructible_v<RES>)
+    {
+      // Assigning reuses whatever the resource has allocated.
+      if (!src)
+        dst.reset();
+      else if (!dst.get())
+        dst.emplace(*src);
+      else if constexpr (std::is_copy_assignable_v<RES>)
+        *dst.get() = *src;
+      else
+        dst.emplace(*src);
+    }
+    else
+    {
+      (dst); (src);
+      throw std::runtime_error{ "Resource type is not copyable!" };
+    }
+  }
+
+  // TStagingBuffer ////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  typename TStagingBuffer<ID_T>::Entity TStagingBuffer<ID_T>::entity_new()
+  {
+    if (next_ == end_)
+    {
+      next_ = world_.entity_reserve(blockSize_);
+      end_ = next_ + blockSize_;
+    }
+    return next_++;
+  }
+
+  template<typename ID_T>
+  template<typename COMP, typename ...ARGS>
+  void TStagingBuffer<ID_T>::comp_add(Entity e, ARGS&&... args)
+  {
+    compReg_.template get_array<COMP>().insert(e.id_, std::forward<ARGS>(args)...);
+  }
+
+  // TPrefab //////////////////////////////////////////////////////////////////
+  template<typename ID_T>
+  template<typename COMP, typename ...ARGS>
+  void TPrefab<ID_T>::comp_add(ARGS&&... args)
+  {
+    TCompArray<COMP, ID_T>& arr = compReg_.template get_array<COMP>();
+    arr.remove(protoId);
+    arr.insert(protoId, std::forward<ARGS>(args)...);
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  void TPrefab<ID_T>::comp_remove()
+  {
+    compReg_.template get_array<COMP>().remove(protoId);
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  COMP* TPrefab<ID_T>::comp_get()
+  {
+    return compReg_.template get_array<COMP>().get(protoId);
+  }
+
+  // Joins ////////////////////////////////////////////////////////////////////
+  template<typename T, typename ARR, typename FUNC>
+  void each_single_array(ARR& compArr, FUNC func)
+  {
+    using C = std::remove_const_t<T>;
+    if constexpr (comp_layout_v<C> == CompLayout::tag)
+    {
+      // Tags only track membership, every entry refers to the same instance.
+      C* tag = compArr.get_by_index(0);
+      for (size_t i = 0; i < compArr.size(); ++i)
+      {
+        func(*tag);
+      }
+    }
+    else if constexpr (comp_layout_v<C> == CompLayout::stable)
+    {
+      for (size_t i = 0; i < compArr.size(); ++i)
+      {
+        func(*compArr.get_by_index(i));
+      }
+    }
+    else if constexpr (comp_layout_v<C> == CompLayout::buffered && std::is_const_v<T>)
+    {
+      auto& vec = compArr.read_array();
+      for (size_t i = 0; i < vec.size(); ++i)
+      {
+        func(vec[i]);
+      }
+    }
+    else
+    {
+      auto& vec = compArr.array();
+      for(size_t i = 0; i < vec.size(); ++i)
+      {
+        func(vec[i]);
+      }
+    }
+  }
+
+  template<typename ID_T, typename ...COMP, typename ARRS, typename FUNC>
+  void join_arrays(ARRS& arrs, FUNC func, FrameArena& arena)
+  {
+    constexpr size_t N = sizeof...(COMP);
+    constexpr size_t npos = std::numeric_limits<size_t>::max();
+    constexpr bool optional[] = { std::is_pointer_v<COMP>... };
+
+    std::apply([](auto*... arr) { (arr->note_join(), ...); }, arrs);
+    if (join_sorted_arrays<ID_T, COMP...>(func, arrs, arena))
+      return;
+
+    TArrayView<ID_T> ids = std::get<0>(arrs)->ids();
+    size_t const total = ids.size();
+
+    ID_T   batchIds[joinBatch];
+    size_t batchInd[joinBatch][N];
+
+    for (size_t base = 0; base < total; base += joinBatch)
+    {
+      size_t const count = std::min(joinBatch, total - base);
+      for (size_t k = 0; k < count; ++k)
+        batchIds[k] = ids[base + k];
+
+      // Stage 1: request the map slots of the secondary arrays.
+      std::apply([&](auto*, auto*... others)
+      {
+        (others->prefetch_ids(batchIds, count), ...);
+      }, arrs);
+
+      // Stage 2: resolve indices and request the dense rows.
+      for (size_t k = 0; k < count; ++k)
+        batchInd[k][0] = base + k;
+      size_t j = 0;
+      std::apply([&](auto*, auto*... others)
+      {
+        ((others->index_of_batch(batchIds, count, &batchInd[0][++j], N)), ...);
+      }, arrs);
+      for (size_t k = 0; k < count; ++k)
+      {
+        j = 0;
+        std::apply([&](auto*... arr)
+        {
+          (arr->prefetch_index(batchInd[k][j++]), ...);
+        }, arrs);
+      }
+
+      // Stage 3: hand matches to the caller.
+      for (size_t k = 0; k < count; ++k)
+      {
+        bool match = true;
+        for (size_t j = 1; j < N; ++j)
+          match &= optional[j] || batchInd[k][j] != npos;
+        if (match)
+          func(batchIds[k], static_cast<size_t const*>(batchInd[k]));
+      }
+    }
+  }
+
+  template<typename ID_T, typename ...COMP, typename FUNC, typename ARRS>
+  bool join_sorted_arrays(FUNC& func, ARRS& arrs, FrameArena& arena)
+  {
+    constexpr size_t N = sizeof...(COMP);
+    constexpr bool optional[] = { std::is_pointer_v<COMP>... };
+    if (N < 2 || optional[0])
+      return false;
+
+    // Arrays are only sorted between ticks, since reordering one here would
+    // invalidate the views taken from it.
+    bool sorted = true;
+    size_t j = 0;
+    std::apply([&](auto*... arr)
+    {
+      ((sorted = sorted && (optional[j] || (arr->sort_mode() && arr->is_sorted())), ++j), ...);
+    }, arrs);
+    if (!sorted)
+      return false;
+
+    std::array<TEntitySet<ID_T>*, N> sets = std::apply([](auto*... arr)
+    {
+      return std::array<TEntitySet<ID_T>*, N>{ arr... };
+    }, arrs);
+
+    // The matches never outnumber the driver's ids, so one column of that
+    // size per type, plus one for the positions kept by each intersection,
+    // is all the room needed.
+    TArrayView<ID_T> first = sets[0]->ids();
+    size_t count = first.size();
+    size_t* const ind = arena.make_array<size_t>((N + 1) * count);
+    size_t* const posA = ind + N * count;
+    ID_T* const ids = arena.make_array<ID_T>(count);
+    std::copy(first.begin(), first.end(), ids);
+    std::iota(ind, ind + count, size_t{ 0 });
+
+    size_t const stride = count;
+    for (j = 1; j < N; ++j)
+    {
+      if (optional[j])
+        continue;
+      TArrayView<ID_T> other = sets[j]->ids();
+      size_t const matches = intersect_sorted(ids, count, other.data(), other.size(), posA, ind + j * stride);
+
+      // Narrow everything gathered so far down to the surviving matches.
+      // Positions are ascending, so this can be done in place.
+      for (size_t m = 0; m < matches; ++m)
+      {
+        ids[m] = ids[posA[m]];
+        for (size_t k = 0; k < j; ++k)
+        {
+          if (!optional[k])
+            ind[k * stride + m] = ind[k * stride + posA[m]];
+        }
+      }
+      count = matches;
+    }
+
+    for (j = 1; j < N; ++j)
+    {
+      if (!optional[j])
+        continue;
+      for (size_t m = 0; m < count; ++m)
+        ind[j * stride + m] = sets[j]->index_of(ids[m]);
+    }
+
+    size_t row[N];
+    for (size_t m = 0; m < count; ++m)
+    {
+      for (size_t k = 0; k < N; ++k)
+        row[k] = ind[k * stride + m];
+      func(ids[m], static_cast<size_t const*>(row));
+    }
 
-  template<typename COMP, typename ID_T>
-  ID_T TCompArray<COMP, ID_T>::get_id(COMP& comp)
-  {
-    return revMap_[&comp - arr_.data()];
+    // Only takes effect if `func` left the arena alone.
+    arena.release(ids, stride * sizeof(ID_T));
+    arena.release(ind, (N + 1) * stride * sizeof(size_t));
+    return true;
   }
 
-  template<typename COMP, typename ID_T>
-  std::vector<COMP>& TCompArray<COMP, ID_T>::array() 
+  template<typename ID_T, typename ...COMP, typename ARRS, typename FUNC>
+  void each_arrays(ARRS& arrs, FUNC func, FrameArena& arena)
   {
-    return arr_;
+    // Call a simpler version of the function if there's only one component.
+    if constexpr (sizeof...(COMP) == 1)
+    {
+      each_single_array<COMP...>(*std::get<0>(arrs), func);
+    }
+    else
+    {
+      join_arrays<ID_T, COMP...>(arrs, [&](ID_T, size_t const* ind)
+      {
+        size_t j = 0;
+        std::apply([&](auto*... arr)
+        {
+          // Braced initialization keeps the index evaluation in order.
+          __detail::OrderedCall{ func, *comp_at<COMP>(arr, ind[j++])... };
+        }, arrs);
+      }, arena);
+    }
   }
 
-  template<typename COMP, typename ID_T>
-  bool TCompArray<COMP, ID_T>::contains(ID_T id)
+  template<typename C, typename ARR, typename T, typename REDUCE, typename TRANSFORM>
+  T transform_reduce_array(ARR& arr, T init, REDUCE reduce, TRANSFORM transform)
   {
-    return get(id);
-  }
+    using B = std::remove_const_t<C>;
+    static_assert(comp_layout_v<B> != CompLayout::tag, "Tags have no values to reduce.");
 
-  template<typename COMP, typename ID_T>
-  size_t TCompArray<COMP, ID_T>::index_of(ID_T ent)
-  {
-    if (map_.size() <= ent || map_[ent] == std::numeric_limits<ID_T>::max())
-      return std::numeric_limits<size_t>::max();
-    return map_[ent];
-  }
-  
-  template<typename COMP, typename ID_T>
-  size_t TCompArray<COMP, ID_T>::size() const
-  {
-    return arr_.size();
+    if constexpr (comp_layout_v<B> == CompLayout::stable)
+    {
+      return parallel_transform_reduce(arr.size(), std::move(init), reduce,
+        [&](size_t i) { return transform(static_cast<B const&>(*arr.get_by_index(i))); });
+    }
+    else
+    {
+      // Contiguous storage, indexed directly so the inner loop can vectorize.
+      B const* data;
+      if constexpr (comp_layout_v<B> == CompLayout::buffered)
+        data = arr.read_array().data();
+      else
+        data = arr.array().data();
+      return parallel_transform_reduce(arr.size(), std::move(init), reduce,
+        [&](size_t i) { return transform(data[i]); });
+    }
   }
 
+  template<typename ID_T, typename ...COMP, typename ARRS>
+  std::shared_ptr<ViewIndices<sizeof...(COMP)> const> ViewCache::get(ARRS& arrs, FrameArena& arena)
+  {
+    constexpr size_t N = sizeof...(COMP);
+    using Indices = ViewIndices<N>;
 
+    // Constness does not change the join, so views differing only in it
+    // share an entry.
+    size_t const key = get_type_id<std::tuple<ViewKeyT<COMP>...>, ViewFamily>();
+    if (entries_.size() <= key)
+      entries_.resize(key + 1);
+    Entry& entry = entries_[key];
 
-  // TCompRegistry /////////////////////////////////////////////////////////////
-  template<typename ID_T>
-  template<typename COMP>
-  TCompArray<COMP, ID_T>& TCompRegistry<ID_T>::get_array()
-  {
-    size_t const key = get_type_id<COMP, ComponentFamily>();
+    auto versions = [&]
+    {
+      return std::apply([](auto*... arr)
+      {
+        return std::array<uint64_t, sizeof...(COMP)>{ arr->version()... };
+      }, arrs);
+    };
 
-    if (reg_.size() <= key)
+    if (entry.valid)
     {
-      //reg_.emplace_back(new TCompArray<COMP, ID_T>{});
-      reg_.resize(key + 1);
+      auto const current = versions();
+      if (std::equal(current.begin(), current.end(), entry.versions.begin()))
+        return std::static_pointer_cast<Indices const>(entry.indices);
     }
 
-    if (reg_[key] == nullptr)
+    // Join into the previous result if no view holds it any more, otherwise
+    // leave it to those views.
+    entry.valid = false;
+    if (!entry.indices || entry.indices.use_count() > 1)
+      entry.indices = std::make_shared<Indices>();
+    Indices& indices = *std::static_pointer_cast<Indices>(entry.indices);
+
+    // The join never yields more sets than the first array or any required
+    // one has components, so every column gets that many slots and the
+    // buffer does not have to grow during the join.
+    constexpr bool optional[] = { std::is_pointer_v<COMP>... };
+    size_t bound = std::get<0>(arrs)->size();
+    std::apply([&](auto*... arr)
     {
-      reg_[key].reset(new TCompArray<COMP, ID_T>{});
-    }
+      size_t j = 0;
+      ((bound = optional[j++] ? bound : std::min(bound, arr->size())), ...);
+    }, arrs);
+    indices.data.resize(N * bound);
+    size_t* const buf = indices.data.data();
+    size_t count = 0;
+    join_arrays<ID_T, COMP...>(arrs, [&](ID_T, size_t const* ind)
+    {
+      for (size_t j = 0; j < N; ++j)
+        buf[j * bound + count] = ind[j];
+      ++count;
+    }, arena);
 
-    std::unique_ptr<ICompArrayBase<ID_T>>& arr = reg_[key];
-    return *dynamic_cast<TCompArray<COMP, ID_T>*>(arr.get());
+    // Close the gaps between the columns.
+    for (size_t j = 1; j < N; ++j)
+      std::memmove(buf + j * count, buf + j * bound, count * sizeof(size_t));
+    indices.data.resize(N * count);
+    for (size_t j = 0; j < N; ++j)
+      indices.ind[j] = buf + j * count;
+    indices.count = count;
+
+    auto const current = versions();
+    entry.versions.assign(current.begin(), current.end());
+    entry.valid = true;
+    return std::static_pointer_cast<Indices const>(entry.indices);
   }
 
+  // TWorld ////////////////////////////////////////////////////////////////////
   template<typename ID_T>
-  void TCompRegistry<ID_T>::remove_all_of(ID_T id)
+  void TWorld<ID_T>::entity_destroy(Entity e)
   {
-    for (auto& arr : reg_)
+    compReg_.remove_all_of(e.id_);
+    indexReg_.update_all(e.id_);
+  }
+
+  template<typename ID_T>
+  void TWorld<ID_T>::staging_merge(StagingBuffer& buf)
+  {
+    // The merge empties the buffer, so the staged ids of indexed types are
+    // gathered first.
+    std::vector<std::pair<uint32_t, ID_T>> staged;
+    indexReg_.each_comp([&](uint32_t comp)
     {
-      if(!arr.get())
-      {
-        continue;
-      }
-      if (arr->contains(id))
+      if (TEntitySet<ID_T>* set = buf.compReg_.find_set(comp))
       {
-        arr->remove(id);
+        for (ID_T id : set->ids())
+          staged.emplace_back(comp, id);
       }
-    }
+    });
+
+    compReg_.merge_from(buf.compReg_);
+    for (auto const& [comp, id] : staged)
+      indexReg_.update(comp, id);
   }
 
-  // TWorld ////////////////////////////////////////////////////////////////////
   template<typename ID_T>
-  void TWorld<ID_T>::entity_destroy(Entity e)
+  typename TWorld<ID_T>::Prefab TWorld<ID_T>::prefab_capture(Entity e)
   {
-    compReg_.remove_all_of(e.id_);
+    Prefab prefab;
+    compReg_.copy_entity(e.id_, prefab.compReg_, Prefab::protoId);
+    return prefab;
+  }
+
+  template<typename ID_T>
+  typename TWorld<ID_T>::Entity TWorld<ID_T>::prefab_instantiate(Prefab const& prefab, ID_T count)
+  {
+    ID_T const first = entity_reserve(count);
+    compReg_.instantiate(prefab.compReg_, Prefab::protoId, first, count);
+    if (!indexReg_.empty())
+    {
+      for (ID_T i = 0; i < count; ++i)
+        indexReg_.update_all(first + i);
+    }
+    return first;
   }
 
   template<typename ID_T>
@@ -229,6 +2121,7 @@ namespace __detail
   {
     TCompArray<COMP, ID_T>& compArr = compReg_.template get_array<COMP>();
     compArr.insert(e.id_, std::forward<ARGS>(args)...);
+    indexReg_.update(get_type_id<COMP, ComponentFamily>(), e.id_);
   }
 
   template<typename ID_T>
@@ -237,6 +2130,7 @@ namespace __detail
   {
     TCompArray<COMP, ID_T>& compArr = compReg_.template get_array<COMP>();
     compArr.remove(e.id_);
+    indexReg_.update(get_type_id<COMP, ComponentFamily>(), e.id_);
   }
 
   template<typename ID_T>
@@ -247,14 +2141,30 @@ namespace __detail
     return compArr.get(e.id_);
   }
 
+  template<typename ID_T>
+  template<typename COMP>
+  COMP const* TWorld<ID_T>::comp_latest(Entity e)
+  {
+    return __detail::comp_latest<COMP>(&compReg_.template get_array<COMP>(), e.id_);
+  }
+
   template<typename ID_T>
   template<typename COMP>
   TArrayView<COMP> TWorld<ID_T>::comp_get()
   {
+    static_assert(comp_layout_v<COMP> == CompLayout::packed,
+      "Only packed components are stored contiguously, use comp_get_entities and comp_get(Entity) instead.");
     TCompArray<COMP, ID_T>& compArr = compReg_.template get_array<COMP>();
     return TArrayView<COMP>{compArr.array().data(), compArr.array().size()};
   }
 
+  template<typename ID_T>
+  template<typename COMP>
+  TArrayView<ID_T> TWorld<ID_T>::comp_get_entities()
+  {
+    return compReg_.template get_array<COMP>().ids();
+  }
+
   template<typename ID_T>
   template<typename COMP>
   typename TWorld<ID_T>::Entity TWorld<ID_T>::comp_get_entity(size_t index)
@@ -272,15 +2182,178 @@ namespace __detail
     return compArr.get_id(comp);
   }
 
+  template<typename ID_T>
+  template<typename COMP>
+  void TWorld<ID_T>::comp_sort()
+  {
+    compReg_.template get_array<COMP>().sort_by_id();
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  void TWorld<ID_T>::comp_keep_sorted(bool keep)
+  {
+    compReg_.template get_array<COMP>().set_sort_mode(keep);
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  void TWorld<ID_T>::comp_set_storage(CompStorage storage)
+  {
+    TCompArray<COMP, ID_T>& compArr = compReg_.template get_array<COMP>();
+    compArr.set_storage(storage);
+    compArr.pin_storage(true);
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  CompStorage TWorld<ID_T>::comp_storage()
+  {
+    return compReg_.template get_array<COMP>().storage();
+  }
+
+  template<typename ID_T>
+  std::vector<CompMemoryStats> TWorld<ID_T>::mem_stats()
+  {
+    return compReg_.memory_stats();
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  void TWorld<ID_T>::index_add(CompIndex kind)
+  {
+    using COMP = FieldCompT<FIELD>;
+    uint32_t const comp = get_type_id<COMP, ComponentFamily>();
+    if (kind == CompIndex::hash)
+      indexReg_.template get<HashIndex<FIELD>>(compReg_.template get_array<COMP>(), comp);
+    else
+      indexReg_.template get<OrderedIndex<FIELD>>(compReg_.template get_array<COMP>(), comp);
+  }
+
+  template<typename ID_T>
+  template<auto FIELD>
+  TArrayView<ID_T> TWorld<ID_T>::index_find(FieldKeyT<FIELD> const& key)
+  {
+    using COMP = FieldCompT<FIELD>;
+    return indexReg_.template get<HashIndex<FIELD>>(compReg_.template get_array<COMP>(),
+      get_type_id<COMP, ComponentFamily>()).find(key);
+  }
+
+  template<typename ID_T>
+  template<auto FIELD, typename FUNC>
+  void TWorld<ID_T>::index_range(FieldKeyT<FIELD> const& lo, FieldKeyT<FIELD> const& hi, FUNC func)
+  {
+    using COMP = FieldCompT<FIELD>;
+    indexReg_.template get<OrderedIndex<FIELD>>(compReg_.template get_array<COMP>(),
+      get_type_id<COMP, ComponentFamily>()).range(lo, hi, [&](ID_T id) { return func(Entity{ id }); });
+  }
+
+  template<typename ID_T>
+  template<auto FIELD, typename ...COMP, typename FUNC>
+  void TWorld<ID_T>::index_each(FieldKeyT<FIELD> const& key, FUNC func)
+  {
+    static_assert(sizeof...(COMP) > 0, "One or more component names required");
+    auto arrs = std::make_tuple(&compReg_.template get_array<std::remove_const_t<COMP>>()...);
+    for (ID_T id : index_find<FIELD>(key))
+    {
+      std::apply([&](auto*... arr)
+      {
+        std::tuple<decltype(comp_of<COMP>(arr, id))...> comps{ comp_of<COMP>(arr, id)... };
+        std::apply([&](auto*... comp)
+        {
+          if ((comp && ...))
+            func(*comp...);
+        }, comps);
+      }, arrs);
+    }
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  void TWorld<ID_T>::comp_changed(Entity e)
+  {
+    indexReg_.update(get_type_id<COMP, ComponentFamily>(), e.id_);
+  }
+
+  template<typename ID_T>
+  void TWorld<ID_T>::mem_shrink()
+  {
+    size_t cursor = 0;
+    compReg_.shrink(cursor, std::numeric_limits<size_t>::max());
+    compactCursor_ = 0;
+  }
+
+  template<typename ID_T>
+  bool TWorld<ID_T>::mem_compact(std::chrono::microseconds budget)
+  {
+    auto const start = std::chrono::steady_clock::now();
+    do
+    {
+      if (compReg_.shrink(compactCursor_, 1))
+        return true;
+    } while (std::chrono::steady_clock::now() - start < budget);
+    return false;
+  }
+
+  template<typename ID_T>
+  bool TWorld<ID_T>::mem_defrag(std::chrono::microseconds budget)
+  {
+    auto const start = std::chrono::steady_clock::now();
+    do
+    {
+      if (!compReg_.defrag(defragStep))
+        return true;
+    } while (std::chrono::steady_clock::now() - start < budget);
+    return false;
+  }
+
+  template<typename ID_T>
+  template<typename RES, typename ...ARGS>
+  RES& TWorld<ID_T>::res_set(ARGS&&... args)
+  {
+    return resReg_.template get_slot<RES>().emplace(std::forward<ARGS>(args)...);
+  }
+
+  template<typename ID_T>
+  template<typename RES>
+  RES* TWorld<ID_T>::res_get()
+  {
+    return resReg_.template get_slot<RES>().get();
+  }
+
+  template<typename ID_T>
+  template<typename RES>
+  void TWorld<ID_T>::res_remove()
+  {
+    resReg_.template get_slot<RES>().reset();
+  }
+
+  template<typename ID_T>
+  template<typename RES>
+  TResource<RES>& TWorld<ID_T>::res_slot()
+  {
+    return resReg_.template get_slot<RES>();
+  }
+
+  template<typename ID_T>
+  template<typename COMP>
+  TCompHandle<COMP, ID_T> TWorld<ID_T>::comp_handle(Entity e)
+  {
+    return TCompHandle<COMP, ID_T>{ &compReg_.template get_array<COMP>(), e.id_ };
+  }
+
   template<typename ID_T>
   template<typename SYS, typename...CON_ARGS>
   void TWorld<ID_T>::sys_add(EventTypes evT, CON_ARGS&&...args)
   {
     static_assert(std::is_base_of_v<SystemBaseType, SYS>);
-    SystemPackage<ID_T> sp;
-    sp.bPtr_ = std::make_unique<SystemPackage<ID_T>::template Derived<SYS>>(
-      new SYS(args...)
-    );
+    // Binding a read-only system may add resource slots to the copy the
+    // pipelined systems are running on.
+    tick_wait();
+    SystemPackage<TWorld> sp;
+    SYS* sys = new SYS(args...);
+    sys->bind_resources(*this);
+    sp.bPtr_ = std::make_unique<typename SystemPackage<TWorld>::template Derived<SYS>>(sys);
 
     switch (evT)
     {
@@ -294,80 +2367,50 @@ namespace __detail
       sysTickBegin_.push_back(std::move(sp));
       break;
     case EventTypes::tickEnd:
+      if constexpr (SYS::readOnly)
+      {
+        pipeDeps_.add(static_cast<typename SYS::CompTypesList*>(nullptr),
+          static_cast<typename SYS::ResTypesList*>(nullptr));
+        sp.readOnly_ = true;
+        if (pipelined_)
+          sp.bPtr_->bind(*pipeWorld_);
+      }
       sysTickEnd_.push_back(std::move(sp));
       break;
     }
   }
 
   template<typename ID_T>
-  template<typename T, typename FUNC>
-  void TWorld<ID_T>::each_single(FUNC func)
+  template<typename ...COMP, typename FUNC>
+  void TWorld<ID_T>::each(FUNC func)
   {
-    /*for (T& t : comp_get<T>())
-    {
-      func(t);
-    }*/
-    TCompArray<T, ID_T>& compArr = compReg_.template get_array<T>();
-    auto& vec = compArr.array();
-    for(size_t i = 0; i < vec.size(); ++i)
-    {
-      func(vec[i]);
-    }
-  }
+    // Needs to supply at least one component
+    static_assert(sizeof...(COMP) > 0, "One or more component names required");
+    static_assert(std::is_invocable_v<FUNC, COMP&...>, "func must be callable type that takes given components as references.");
 
-  template<typename ID_T>
-  template<typename FUNC, typename T, size_t... IS>
-  void TWorld<ID_T>::each_func_exec(FUNC func, T args, std::index_sequence<IS...>)
-  {
-    func(*std::get<IS>(args)...);
+    std::tuple<TCompArray<std::remove_const_t<COMP>, ID_T>*...> arrs{
+      &compReg_.template get_array<std::remove_const_t<COMP>>()...
+    };
+    each_arrays<ID_T, COMP...>(arrs, func, frameArena_);
   }
 
   template<typename ID_T>
-  template<typename COMP, typename FROM_COMP>
-  COMP* TWorld<ID_T>::each_get_ptr(size_t i, TCompArray<FROM_COMP, ID_T>& fromCompArr, bool& noNull)
+  template<typename COMP, typename T, typename REDUCE>
+  T TWorld<ID_T>::reduce(T init, REDUCE reduce)
   {
-    if (!noNull)
-      return nullptr;
-    auto& compArr = compReg_.template get_array<COMP>();
-    auto ptr = compArr.get(fromCompArr.get_id(i));
-    if (!ptr)
-    {
-      noNull = false;
-      return nullptr;
-    }
-    return ptr;
+    return transform_reduce<COMP>(std::move(init), reduce, [](auto const& c) { return c; });
   }
 
   template<typename ID_T>
-  template<typename ...COMP, typename FUNC>
-  void TWorld<ID_T>::each(FUNC func)
+  template<typename ...COMP, typename T, typename REDUCE, typename TRANSFORM>
+  T TWorld<ID_T>::transform_reduce(T init, REDUCE reduce, TRANSFORM transform)
   {
-    // Needs to supply at least one component
     static_assert(sizeof...(COMP) > 0, "One or more component names required");
-    static_assert(std::is_invocable_v<FUNC, COMP&...>, "func must be callable type that takes given components as references.");
-
-    // Call a simpler version of the function if there's only one component.
     if constexpr (sizeof...(COMP) == 1)
-    {
-      each_single<COMP...>(func);
-      return;
-    }
+      return transform_reduce_array<COMP...>(compReg_.template get_array<std::remove_const_t<COMP>...>(),
+        std::move(init), reduce, transform);
     else
-    {
-      auto& compArr = compReg_.template get_array<typename std::tuple_element<0, std::tuple<COMP...>>::type>();
-      auto& firstVec = compArr.array();
-      for (size_t i = 0; i < firstVec.size(); i++)
-      {
-        bool noNull = true;
-        std::tuple<COMP*...> ptrs = std::make_tuple(each_get_ptr<COMP>(i, compArr, noNull)...);
-
-        if (noNull)
-        {
-          // Execute the function...?
-          each_func_exec(func, ptrs, std::make_index_sequence<sizeof...(COMP)>{});
-        }
-      }
-    }
+      return view_get<COMP...>().transform_reduce(std::move(init), reduce, transform);
   }
 
   template<typename ID_T>
@@ -381,54 +2424,110 @@ namespace __detail
     {
       s.bPtr_->run(this);
     }
+#ifdef ECS_HAS_COROUTINES
+    coSched_.run_slot();
+#endif
     for (auto& s : sysTickEnd_)
     {
-      s.bPtr_->run(this);
+      if (!pipelined_ || !s.readOnly_)
+        s.bPtr_->run(this);
+    }
+#ifdef ECS_HAS_COROUTINES
+    coSched_.run_sync();
+#endif
+    if (pipelined_)
+      pipeline_start();
+    // Publish what was written this tick to the readers of the next one.
+    compReg_.swap_buffers();
+    // Mappings are only rebuilt between ticks, never while systems run.
+    if (autoStorage_)
+      compReg_.adapt_storage();
+    // Joins only intersect arrays that are still sorted.
+    compReg_.sort_kept();
+    if (defragBudget_.count() > 0)
+      mem_defrag(defragBudget_);
+    // Cached joins only live for one tick, and so does the memory they use.
+    viewCache_.release();
+    frameArena_.reset();
+  }
+
+  template<typename ID_T>
+  TWorld<ID_T>::~TWorld()
+  {
+    // Errors of the last pipelined tick have nowhere to go.
+    if (pipeJob_.valid())
+      pipeJob_.wait();
+  }
+
+  template<typename ID_T>
+  void TWorld<ID_T>::tick_pipelined(bool enable)
+  {
+    tick_wait();
+    if (enable && !pipeWorld_)
+      pipeWorld_ = std::make_unique<TWorld>();
+    pipelined_ = enable;
+    for (auto& s : sysTickEnd_)
+    {
+      if (s.readOnly_)
+        s.bPtr_->bind(enable ? *pipeWorld_ : *this);
+    }
+  }
+
+  template<typename ID_T>
+  void TWorld<ID_T>::tick_wait()
+  {
+    if (pipeJob_.valid())
+      pipeJob_.get();
+  }
+
+  template<typename ID_T>
+  void TWorld<ID_T>::pipeline_start()
+  {
+    tick_wait();
+
+    // The copy is joined afresh every tick.
+    TWorld& snap = *pipeWorld_;
+    snap.viewCache_.release();
+    snap.frameArena_.reset();
+    snap.compReg_.assign_from(compReg_, pipeDeps_.comps);
+    pipeDeps_.copy_res(resReg_, snap.resReg_);
+
+    // The job walks a list taken now rather than `sysTickEnd_` itself.
+    pipeSystems_.clear();
+    for (auto& s : sysTickEnd_)
+    {
+      if (s.readOnly_)
+        pipeSystems_.push_back(s.bPtr_.get());
     }
+
+    pipeJob_ = WorkerPool::shared().submit([this, &snap]
+    {
+      for (SystemBase<TWorld>* s : pipeSystems_)
+        s->run(&snap);
+    });
   }
 
   template <typename ID_T>
   template <typename ...COMP>
   TComponentView<ID_T, COMP...> TWorld<ID_T>::view_get()
   {
-    TComponentView<ID_T, COMP...> ret{ *this };
-
     if constexpr (sizeof...(COMP) == 0)
-      return ret;
-
-    // Very roundabout way of getting the number of components in one of the arrays.
-    auto& compArr = compReg_.template get_array<typename std::tuple_element<0, std::tuple<std::remove_pointer_t<COMP>...>>::type>();
-    auto& firstVec = compArr.array();
-    for (size_t i = 0; i < firstVec.size(); i++)
+      return TComponentView<ID_T>{ this };
+    else
     {
-      bool noNull = true;
-      ID_T ent = compArr.get_id(i);
-      size_t indices[] = {
-        ([&]
-        {
-          size_t i = 0;
-          if (noNull)
-          {
-            i = compReg_.template get_array<std::remove_pointer_t<COMP>>().index_of(ent);
-            if (i == std::numeric_limits<size_t>::max() && !std::is_pointer_v<COMP>)
-              noNull = false;
-          }
-          return i;
-        }())...
+      typename TComponentView<ID_T, COMP...>::Arrays arrs{
+        &compReg_.template get_array<std::remove_const_t<std::remove_pointer_t<COMP>>>()...
       };
-
-      if (noNull)
-      {
-        // put the indices in the comp view
-        for (size_t j = 0; j < sizeof...(COMP); ++j)
-        {
-          ret.ind_[j].push_back(indices[j]);
-        }
-      }
+      return TComponentView<ID_T, COMP...>{ this, arrs, viewCache_.template get<ID_T, COMP...>(arrs, frameArena_) };
     }
-
-    return ret;
   }
 
-
+  template <typename ID_T>
+  template <typename ...COMP>
+  TLazyView<ID_T, COMP...> TWorld<ID_T>::view_lazy()
+  {
+    return TLazyView<ID_T, COMP...>{ this, typename TLazyView<ID_T, COMP...>::Arrays{
+      &compReg_.template get_array<std::remove_const_t<std::remove_pointer_t<COMP>>>()...
+    } };
+  }
 }
@@ -3,29 +3,194 @@
 ///@brief  Primary interface for the ECS framework.
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <tuple>
 #include <vector>
 #include <functional>
 #include <memory>
+#include <limits>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include <typeinfo>
+#include <new>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
 
 #include "array-view.hpp"
+#include "intersect.hpp"
+#include "reduce.hpp"
+#include "worker-pool.hpp"
+#include "coroutine.hpp"
+#include "frame-arena.hpp"
+#include "index.hpp"
 #include "typeid.hpp"
 
 #ifdef max
 #undef max
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define ECS_PREFETCH(ptr) _mm_prefetch(reinterpret_cast<const char*>(ptr), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define ECS_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define ECS_PREFETCH(ptr) ((void)(ptr))
+#endif
+
+#if defined(_MSC_VER)
+#define ECS_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+#define ECS_NOINLINE __attribute__((noinline))
+#else
+#define ECS_NOINLINE
+#endif
+
 template<typename T, typename... T2>
 class TComponentView;
 
+template<typename T, typename... T2>
+class TLazyView;
+
+///@brief Ways a component array can map entity ids to its components.
+enum class CompStorage
+{
+  sparse, ///< Paged map, pages are only allocated for ids in use. The default.
+  dense,  ///< One flat map covering every id up to the highest one, without
+          ///< the page lookup. Best for components most entities have.
+  hashed  ///< Hash map of the ids present. Best for rare components, whose
+          ///< pages would otherwise be almost empty.
+};
+
+///@brief Storage options of a component type. Specialize for a component type
+///       and declare any of the following to change how it is stored:
+///       - `static constexpr bool stable`: keeps each component at the same
+///         address from insertion until removal, at the cost of an extra
+///         indirection when iterating. Defaults to false.
+///       - `static constexpr bool relocatable`: the type may be moved to a new
+///         address with a plain byte copy (no self-pointers, no registration
+///         by address). Removal and sorting then move raw bytes instead of
+///         calling move operations. Defaults to `std::is_trivially_copyable`.
+///       - `static constexpr bool doubleBuffered`: keeps a snapshot of the
+///         previous tick next to the components being written. Systems that
+///         take the type as const read the snapshot, so they do not have to
+///         be ordered against the systems writing it. Defaults to false.
+///       - `static constexpr CompStorage storage`: how entity ids are mapped
+///         to components. Types that declare it are never switched by
+///         `TWorld::comp_auto_storage`. Defaults to `CompStorage::sparse`.
+template<typename COMP>
+struct CompTraits {};
+
 namespace __detail
 {
   using ComponentFamily = struct ComponentFamily_;
+  using ViewFamily = struct ViewFamily_;
+
+  ///@brief Storage layouts used by component arrays.
+  enum class CompLayout
+  {
+    packed,  ///< Contiguous array, holes are filled by moving the last element.
+    tag,     ///< Membership only, used for empty types.
+    stable,  ///< Paged slots that never move, selected by `CompTraits::stable`.
+    buffered ///< Read and write arrays, see `CompTraits::doubleBuffered`.
+  };
+
+  template<typename COMP, typename = void>
+  struct CompStable : std::false_type {};
+  template<typename COMP>
+  struct CompStable<COMP, std::void_t<decltype(CompTraits<COMP>::stable)>>
+    : std::bool_constant<CompTraits<COMP>::stable> {};
+
+  template<typename COMP, typename = void>
+  struct CompBuffered : std::false_type {};
+  template<typename COMP>
+  struct CompBuffered<COMP, std::void_t<decltype(CompTraits<COMP>::doubleBuffered)>>
+    : std::bool_constant<CompTraits<COMP>::doubleBuffered> {};
+
+  template<typename COMP, typename = void>
+  struct CompRelocatable : std::is_trivially_copyable<COMP> {};
+  template<typename COMP>
+  struct CompRelocatable<COMP, std::void_t<decltype(CompTraits<COMP>::relocatable)>>
+    : std::bool_constant<CompTraits<COMP>::relocatable> {};
+
+  template<typename COMP, typename = void>
+  struct CompStorageOf : std::integral_constant<CompStorage, CompStorage::sparse>
+  {
+    static constexpr bool declared = false;
+  };
+  template<typename COMP>
+  struct CompStorageOf<COMP, std::void_t<decltype(CompTraits<COMP>::storage)>>
+    : std::integral_constant<CompStorage, CompTraits<COMP>::storage>
+  {
+    static constexpr bool declared = true;
+  };
+
+  template<typename COMP>
+  inline constexpr CompLayout comp_layout_v =
+    std::is_empty_v<COMP> ? CompLayout::tag :
+    CompStable<COMP>::value ? CompLayout::stable :
+    CompBuffered<COMP>::value ? CompLayout::buffered :
+    CompLayout::packed;
+
+  template<typename COMP>
+  inline constexpr bool comp_relocatable_v = CompRelocatable<COMP>::value;
+
+  ///@brief Exchanges two objects byte-wise, without calling any of their
+  ///       special members. Only valid for relocatable types.
+  template<typename T>
+  void relocate_swap(T& a, T& b)
+  {
+    alignas(T) unsigned char tmp[sizeof(T)];
+    std::memcpy(tmp, static_cast<void*>(&a), sizeof(T));
+    std::memcpy(static_cast<void*>(&a), static_cast<void*>(&b), sizeof(T));
+    std::memcpy(static_cast<void*>(&b), tmp, sizeof(T));
+  }
+
+  ///@brief  Gets the implementation defined name of a type.
+  ///@return The name, or an empty string when built without RTTI.
+  template<typename T>
+  char const* type_name()
+  {
+#ifdef __cpp_rtti
+    return typeid(T).name();
+#else
+    return "";
+#endif
+  }
 
   // TCompArray /////////////////////////////////////////////////////////////////
+  ///@brief Memory usage of a single component array.
+  struct CompMemoryStats
+  {
+    uint32_t    typeId = 0;         ///< Component type id.
+    const char* typeName = "";      ///< Implementation defined type name,
+                                    ///< empty when built without RTTI.
+    size_t      count = 0;          ///< Number of live components.
+    size_t      capacity = 0;       ///< Components the dense storage can hold.
+    size_t      denseBytes = 0;     ///< Bytes allocated for component storage.
+    size_t      revMapBytes = 0;    ///< Bytes allocated for the index->id map.
+    size_t      mapBytes = 0;       ///< Bytes allocated for the id->index map.
+    size_t      mapPages = 0;       ///< Allocated pages of the id->index map.
+    size_t      mapEmptyPages = 0;  ///< Allocated map pages with no live entry.
+    float       mapFill = 0.f;      ///< Live entries / allocated map slots.
+    size_t      unusedBytes = 0;    ///< Spare dense capacity plus empty pages.
+    CompStorage storage = CompStorage::sparse;   ///< Current id mapping.
+    CompStorage suggested = CompStorage::sparse; ///< Mapping best suited to
+                                                 ///< the current occupancy.
+
+    size_t total_bytes() const { return denseBytes + revMapBytes + mapBytes; }
+  };
+
   template<typename ID_T>
   struct ICompArrayBase
   {
+    virtual ~ICompArrayBase() = default;
+
     virtual void remove(ID_T id)
     {
       (id);
@@ -43,18 +208,254 @@ namespace __detail
       (ent);
       throw std::runtime_error{ "Not implemented!" };
     }
+
+    virtual CompMemoryStats memory_stats()
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void shrink()
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void clear()
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void merge_from(ICompArrayBase&)
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void sort_by_id()
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual std::unique_ptr<ICompArrayBase> make_empty()
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void copy_to(ID_T, ICompArrayBase&, ID_T)
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void fill_from(ICompArrayBase&, ID_T, ID_T, ID_T)
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void assign_from(ICompArrayBase&)
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    // Only double-buffered arrays have anything to swap.
+    virtual void swap_buffers() {}
+
+    virtual bool adapt_storage()
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual void swap_entries(size_t, size_t)
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
+
+    virtual bool defrag_step(size_t)
+    {
+      throw std::runtime_error{ "Not implemented!" };
+    }
   };
 
+  // TEntitySet /////////////////////////////////////////////////////////////////
+  ///@brief Sparse set of entity ids. Tracks which entities own a component and
+  ///       where in the dense component array each one lives.
+  template<typename ID_T>
+  class TEntitySet : public ICompArrayBase<ID_T>
+  {
+  public:
+    ///@param storage The initial id mapping.
+    ///@param pinned  True if `adapt_storage` must leave the mapping alone.
+    explicit TEntitySet(CompStorage storage = CompStorage::sparse, bool pinned = false)
+      : storage_{ storage }, storagePinned_{ pinned } {}
+    ///@brief      Gets the entity id associated with the given index.
+    ///@param index The index to get the entity of.
+    ///@return      The entity id.
+    ID_T get_id(size_t index);
+    ///@brief  Gets the ids of every entity in the set, in dense order.
+    ///@return Array view of the entity ids.
+    TArrayView<ID_T> ids();
+    ///@brief     Checks if the set contains the given entity id.
+    ///@param  id The entity id to check against.
+    ///@return    True if the id was found, false otherwise.
+    bool contains(ID_T id) override;
+    ///@brief     Gets the dense index of the given entity.
+    ///@param ent Entity ID to check for.
+    ///@return    The index into the dense arrays. Returns
+    ///           numeric_limits<size_t>::max() on failure.
+    size_t index_of(ID_T ent) override;
+    ///@brief  Gets the number of entities currently contained by the set.
+    ///@return Size of the set.
+    size_t size() const;
+    ///@brief  Checks if the dense order is ascending by entity id.
+    ///@return True if sorted.
+    bool is_sorted() const { return sorted_; }
+    ///@brief  Checks if the set is kept sorted for joins.
+    ///@return True if sorted mode is enabled.
+    bool sort_mode() const { return keepSorted_; }
+    ///@brief      Sets whether the set should be kept sorted by entity id.
+    ///            Joins intersect the id lists of sets that are, see
+    ///            `TCompRegistry::sort_kept`.
+    ///@param keep True to enable sorted mode.
+    void set_sort_mode(bool keep) { keepSorted_ = keep; }
+    ///@brief  Gets a counter that changes whenever ids are added, removed or
+    ///        reordered, so cached join results can be validated.
+    ///@return The current version.
+    uint64_t version() const { return version_; }
+    ///@brief    Hints the CPU to fetch the map slot of the given id.
+    ///@param id The entity id that will be looked up soon.
+    void prefetch_id(ID_T id);
+    ///@brief       Hints the CPU to fetch the map slots of the given ids.
+    ///@param ids   The entity ids that will be looked up soon.
+    ///@param count Number of ids.
+    void prefetch_ids(ID_T const* ids, size_t count);
+    ///@brief        Gets the dense index of each of the given ids, as
+    ///              `index_of`. The mapping is dispatched on once for the
+    ///              whole batch.
+    ///@param ids    The entity ids to look up.
+    ///@param count  Number of ids.
+    ///@param out    Receives the index of `ids[k]` in `out[k * stride]`.
+    ///@param stride Distance between consecutive results.
+    void index_of_batch(ID_T const* ids, size_t count, size_t* out, size_t stride);
+    ///@brief  Reports the memory used by the id mappings. Dense component
+    ///        fields are left for derived arrays to fill in.
+    CompMemoryStats memory_stats() override;
+    ///@brief Releases spare capacity, empty map pages and the trailing part of
+    ///       the page table that holds no pages.
+    void shrink() override;
+    ///@brief Removes every id from the set, keeping allocated memory.
+    void clear() override;
+    ///@return The current id mapping.
+    CompStorage storage() const { return storage_; }
+    ///@brief         Rebuilds the id mapping with the given storage. Dense
+    ///               indices, and thus component addresses, are unaffected.
+    ///@param storage The mapping to switch to.
+    void set_storage(CompStorage storage);
+    ///@brief  Picks the mapping best suited to the current occupancy, that is
+    ///        the number of ids relative to the highest id ever added. The
+    ///        thresholds leave some room around the current mapping so that
+    ///        sets near a boundary do not switch back and forth.
+    ///@return The suggested mapping.
+    CompStorage suggest_storage() const;
+    ///@brief Prevents or allows changes by `adapt_storage`.
+    void pin_storage(bool pinned) { storagePinned_ = pinned; }
+    ///@brief  Switches to the suggested mapping, unless pinned.
+    ///@return True if the mapping was changed.
+    bool adapt_storage() override;
+    ///@brief Counts a join the set takes part in, see `join_count`.
+    void note_join() { ++joins_; }
+    ///@return Number of joins the set took part in, used to pick the order
+    ///        in which sets are defragmented.
+    uint64_t join_count() const { return joins_; }
+    ///@brief       Advances an incremental sort by entity id. A pass takes the
+    ///             sorted order once, then each step fills the next indices
+    ///             from it with at most `count` swaps. Other changes to the
+    ///             set between steps make the pass take the order again, but
+    ///             keep the entries already moved.
+    ///@param count Maximum number of entries to swap.
+    ///@return      True once the set is sorted.
+    bool defrag_step(size_t count) override;
+  protected:
+    /// Number of ids covered by one page of the id->index map.
+    static constexpr size_t pageSize = 4096;
+
+    struct Page
+    {
+      std::unique_ptr<ID_T[]> slots;
+      size_t                  live = 0;
+    };
+
+    ///@return Pointer to the map slot of the given id. Returns `nullptr` if
+    ///        its page is not allocated.
+    ID_T* map_slot(ID_T id);
+    ///@brief Out of line part of `map_slot` for hashed sets, so that the
+    ///       lookups of the other mappings stay small enough to inline.
+    ECS_NOINLINE ID_T* hash_slot(ID_T id);
+
+    ///@brief    Appends the given id to the set.
+    ///@param id The entity id to add.
+    ///@return   The dense index of the new entry. Returns
+    ///          numeric_limits<size_t>::max() if the id is already present.
+    size_t set_insert(ID_T id);
+    ///@brief       Appends the ids `first` to `first + count - 1` to the set,
+    ///             filling the map one page at a time. None of the ids may
+    ///             already be present.
+    ///@param first The first entity id to add.
+    ///@param count Number of ids to add.
+    ///@return      The dense index of the first new entry.
+    size_t set_insert_range(ID_T first, ID_T count);
+    ///@brief    Removes the given id from the set. The last entry is moved into
+    ///          the freed slot, so callers must mirror the move in any array
+    ///          sharing the set's indices.
+    ///@param id The entity id to remove.
+    ///@return   The freed dense index. Returns numeric_limits<size_t>::max() if
+    ///          the id was not present.
+    size_t set_remove(ID_T id);
+    ///@brief Exchanges the ids at two dense indices. Callers must exchange
+    ///       the matching components too.
+    void set_swap(size_t i, size_t j);
+    ///@brief       Makes the set a copy of `other`, reusing the memory it
+    ///             already holds. Callers must copy the components too.
+    ///@param other The set to copy.
+    void set_assign(TEntitySet const& other);
+    ///@brief  Computes the order that sorts the set by entity id.
+    ///@return Dense indices, listed in ascending id order.
+    std::vector<size_t> sorted_order() const;
+    ///@brief       Rearranges the set so that new index `i` holds the entry at
+    ///             old index `order[i]`. Callers must apply the same order to
+    ///             any array sharing the set's indices.
+    ///@param order A permutation of the dense indices.
+    void apply_order(std::vector<size_t> const& order);
+
+    ///@brief Gets the given page of the sparse map, allocating it if needed.
+    Page& map_page(size_t page);
+
+    std::vector<Page>              map_;
+    std::vector<ID_T>              flat_;
+    std::unordered_map<ID_T, ID_T> hash_;
+    std::vector<ID_T>              revMap_;
+    uint64_t                       version_ = 0;
+    size_t                         idEnd_ = 0;
+    uint64_t                       joins_ = 0;
+    std::vector<ID_T>              defragIds_;     ///< Ids of the pass in order.
+    size_t                         defragPos_ = 0; ///< Next index to fill.
+    uint64_t                       defragVersion_ = 0;
+    CompStorage                    storage_;
+    bool                           storagePinned_;
+    bool                           sorted_ = true;
+    bool                           keepSorted_ = false;
+  };
+
+  // TCompArray /////////////////////////////////////////////////////////////////
   ///@brief Type that manages the mappings between components and entities.
-  template<typename COMP, typename ID_T>
-  class TCompArray : public ICompArrayBase<ID_T>
+  ///       Empty component types (tags) and stable component types are handled
+  ///       by specializations, see `CompLayout`.
+  template<typename COMP, typename ID_T, CompLayout LAYOUT = comp_layout_v<COMP>>
+  class TCompArray final : public TEntitySet<ID_T>
   {
   public:
     TCompArray();
-    ///@brief      Emplaces a component.
+    ///@brief      Emplaces a component. Exceptions thrown by its constructor
+    ///            propagate and leave the array unchanged.
     ///@param id   Entity id to assign to.
     ///@param args arguments to construct the component with.
-    ///@return     True if successful, false if not.
+    ///@return     True if successful, false if the entity already has one.
     template<typename ...ARGS>
     bool insert(ID_T id, ARGS&&... args);
     ///@brief    Removes the component assigned to the given entity.
@@ -65,10 +466,10 @@ namespace __detail
     ///@return   The attached component. Returns `nullptr` if none was found.
     COMP* get(ID_T id);
     COMP* get_by_index(size_t i);
-    ///@brief       Gets the entity id associated with the given component index.
-    ///@param index The component index to get the entity of.
-    ///@return      The entity id. Returns value of `Entity::invalid()` if none.
-    ID_T get_id(size_t index);
+    ///@brief   Hints the CPU to fetch the component at the given index.
+    ///@param i The index that will be accessed soon. Ignored if out of range.
+    void prefetch_index(size_t i);
+    using TEntitySet<ID_T>::get_id;
     ///@brief      Gets the entity id associated with the given component.
     ///@param comp Component to get entity of.
     ///@return     The entity id. Returns value of `Entity::invalid()` if none.
@@ -76,27 +477,242 @@ namespace __detail
     ///@brief  Gets the underlying array of components.
     ///@return The underlying array of components.
     std::vector<COMP>& array();
-    ///@brief     Checks if the component array contains a component assigned to
-    ///           the given entity id.
-    ///@param  id The entity id to check against.
-    ///@return    True if a component was found, false otherwise.
-    bool contains(ID_T id) override;
-    ///@brief     Gets the component index of the component attached to the
-    ///           given entity.
-    ///@param ent Entity ID to check for.
-    ///@return    The index into the component array of the attached
-    ///           component. Returns numeric_limits<size_t>::max() on failure.
-    size_t index_of(ID_T ent) override;
-    ///@brief   Gets the number of components currently contained by the component
-    ///         array.
-    ///@return  Size of component array.
-    size_t size() const;
+    ///@brief Reorders the components so that they are ascending by entity id.
+    void sort_by_id() override;
+    ///@brief Exchanges the components, and their ids, at two dense indices.
+    void swap_entries(size_t i, size_t j) override;
+    CompMemoryStats memory_stats() override;
+    void shrink() override;
+    void clear() override;
+    ///@brief       Moves every component of `other`, which must be an array of
+    ///             the same type, into this array and clears it. Entities that
+    ///             already have the component keep their current one.
+    ///@param other The array to merge from.
+    void merge_from(ICompArrayBase<ID_T>& other) override;
+    std::unique_ptr<ICompArrayBase<ID_T>> make_empty() override;
+    ///@brief       Inserts a copy of the component of `id` into `dst`, which
+    ///             must be an array of the same type.
+    ///@param id    The entity to copy from.
+    ///@param dst   The array to copy into.
+    ///@param dstId The entity to assign the copy to.
+    void copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId) override;
+    ///@brief         Appends `count` copies of the component `proto` holds for
+    ///               `protoId`, assigned to the ids `first` onwards. Storage
+    ///               grows once and the ids are mapped in a single pass. The
+    ///               ids must not already have the component.
+    ///@param proto   Array of the same type holding the prototype.
+    ///@param protoId The entity owning the prototype component.
+    ///@param first   The first entity to assign a copy to.
+    ///@param count   Number of copies.
+    void fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count) override;
+    ///@brief       Replaces the contents with a copy of `other`, which must be
+    ///             an array of the same type. Memory already held is reused.
+    ///@param other The array to copy.
+    void assign_from(ICompArrayBase<ID_T>& other) override;
   private:
     std::vector<COMP> arr_;
-    std::vector<ID_T> map_;
-    std::vector<ID_T> revMap_;
   };
 
+  ///@brief Storage for empty component types. Only membership is tracked; every
+  ///       lookup of a present tag yields the same shared instance.
+  template<typename COMP, typename ID_T>
+  class TCompArray<COMP, ID_T, CompLayout::tag> final : public TEntitySet<ID_T>
+  {
+  public:
+    TCompArray() : TEntitySet<ID_T>{ CompStorageOf<COMP>::value, CompStorageOf<COMP>::declared } {}
+    template<typename ...ARGS>
+    bool insert(ID_T id, ARGS&&... args);
+    void remove(ID_T id) override;
+    ///@return The shared tag instance, or `nullptr` if the entity has no tag.
+    COMP* get(ID_T id);
+    COMP* get_by_index(size_t i);
+    void prefetch_index(size_t) {}
+    using TEntitySet<ID_T>::get_id;
+    ///@brief  Tags share a single address, so the owner can not be recovered.
+    ///@return Always the value of `Entity::invalid()`.
+    ID_T get_id(COMP& comp);
+    void sort_by_id() override;
+    void swap_entries(size_t i, size_t j) override;
+    CompMemoryStats memory_stats() override;
+    void merge_from(ICompArrayBase<ID_T>& other) override;
+    std::unique_ptr<ICompArrayBase<ID_T>> make_empty() override;
+    void copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId) override;
+    void fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count) override;
+    void assign_from(ICompArrayBase<ID_T>& other) override;
+  private:
+    inline static COMP instance_{};
+  };
+
+  ///@brief Storage for component types with `CompTraits::stable` set. The
+  ///       components live in fixed pages of slots and are never moved, only
+  ///       the dense list of pointers to them is rearranged. Freed slots are
+  ///       reused by later inserts, and pages left empty are released by
+  ///       `shrink`.
+  template<typename COMP, typename ID_T>
+  class TCompArray<COMP, ID_T, CompLayout::stable> final : public TEntitySet<ID_T>
+  {
+    static_assert(!CompBuffered<COMP>::value, "Stable components can not be double-buffered.");
+  public:
+    TCompArray() : TEntitySet<ID_T>{ CompStorageOf<COMP>::value, CompStorageOf<COMP>::declared } {}
+    TCompArray(TCompArray const&) = delete;
+    ~TCompArray() override;
+    template<typename ...ARGS>
+    bool insert(ID_T id, ARGS&&... args);
+    void remove(ID_T id) override;
+    COMP* get(ID_T id);
+    COMP* get_by_index(size_t i);
+    void prefetch_index(size_t i);
+    using TEntitySet<ID_T>::get_id;
+    ID_T get_id(COMP& comp);
+    void sort_by_id() override;
+    void swap_entries(size_t i, size_t j) override;
+    CompMemoryStats memory_stats() override;
+    void shrink() override;
+    void clear() override;
+    void merge_from(ICompArrayBase<ID_T>& other) override;
+    std::unique_ptr<ICompArrayBase<ID_T>> make_empty() override;
+    void copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId) override;
+    void fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count) override;
+    ///@brief Replaces the contents with copies of the components of `other`.
+    ///       They get new addresses, as with any insertion.
+    void assign_from(ICompArrayBase<ID_T>& other) override;
+  private:
+    /// Number of slots per page.
+    static constexpr size_t slotsPerPage = 256;
+
+    struct Slot
+    {
+      alignas(COMP) unsigned char data[sizeof(COMP)];
+      ID_T owner = std::numeric_limits<ID_T>::max();
+      uint32_t page = 0;
+
+      COMP* comp() { return std::launder(reinterpret_cast<COMP*>(data)); }
+    };
+
+    struct SlotPage
+    {
+      std::unique_ptr<Slot[]> slots;
+      size_t                  live = 0;
+    };
+
+    ///@return A free slot, allocating a new page if needed.
+    Slot* acquire_slot();
+    std::vector<SlotPage> pages_;
+    std::vector<Slot*>    free_;
+    std::vector<Slot*>    ptrs_;
+  };
+
+  ///@brief Storage for component types with `CompTraits::doubleBuffered` set.
+  ///       Two parallel arrays share the set's indices. `read` accessors see
+  ///       the previous tick's snapshot, every other access writes the next
+  ///       tick's values. At the end of a tick in which the write array was
+  ///       handed out the two trade places in O(1); the write array is then
+  ///       refreshed with one bulk copy on its next write access.
+  template<typename COMP, typename ID_T>
+  class TCompArray<COMP, ID_T, CompLayout::buffered> final : public TEntitySet<ID_T>
+  {
+    static_assert(std::is_copy_constructible_v<COMP> && std::is_copy_assignable_v<COMP>,
+      "Double-buffered components must be copyable.");
+  public:
+    TCompArray() : TEntitySet<ID_T>{ CompStorageOf<COMP>::value, CompStorageOf<COMP>::declared } {}
+    ///@brief Adds the component to both the snapshot and the write array.
+    template<typename ...ARGS>
+    bool insert(ID_T id, ARGS&&... args);
+    void remove(ID_T id) override;
+    ///@return The component being written for the next tick, or `nullptr`.
+    COMP* get(ID_T id);
+    COMP* get_by_index(size_t i);
+    ///@return The component as of the previous tick, or `nullptr`.
+    COMP const* read(ID_T id);
+    COMP const* read_by_index(size_t i) const;
+    ///@return The value `get` would return, or `nullptr`. Does not hand out
+    ///        the write array, so only reading leaves the snapshot as is.
+    COMP const* latest(ID_T id);
+    COMP const* latest_by_index(size_t i) const;
+    void prefetch_index(size_t i);
+    using TEntitySet<ID_T>::get_id;
+    ///@brief Accepts components of either array.
+    ID_T get_id(COMP const& comp);
+    ///@return The components being written for the next tick.
+    std::vector<COMP>& array();
+    ///@return The components as of the previous tick.
+    std::vector<COMP> const& read_array() const { return read_; }
+    void sort_by_id() override;
+    void swap_entries(size_t i, size_t j) override;
+    CompMemoryStats memory_stats() override;
+    void shrink() override;
+    void clear() override;
+    void merge_from(ICompArrayBase<ID_T>& other) override;
+    std::unique_ptr<ICompArrayBase<ID_T>> make_empty() override;
+    void copy_to(ID_T id, ICompArrayBase<ID_T>& dst, ID_T dstId) override;
+    void fill_from(ICompArrayBase<ID_T>& proto, ID_T protoId, ID_T first, ID_T count) override;
+    ///@brief Copies both arrays of `other`, so readers see the same snapshot.
+    void assign_from(ICompArrayBase<ID_T>& other) override;
+    ///@brief Publishes the written components as the new snapshot, if any
+    ///       were handed out since the last swap.
+    void swap_buffers() override;
+  private:
+    ///@brief Brings the write array up to date before it is handed out.
+    void begin_write()
+    {
+      if (!synced_)
+      {
+        write_ = read_;
+        synced_ = true;
+      }
+      written_ = true;
+    }
+
+    ///@return The most recent value of the component at the given index.
+    COMP& current(size_t i) { return synced_ ? write_[i] : read_[i]; }
+    COMP const& current(size_t i) const { return synced_ ? write_[i] : read_[i]; }
+
+    std::vector<COMP> read_;
+    std::vector<COMP> write_;
+    bool              synced_ = true;   ///< write_ is at least as new as read_.
+    bool              written_ = false; ///< write_ was handed out since the swap.
+  };
+
+  ///@brief Gets the component at the given index of an array for access as
+  ///       `C`. Const access to double-buffered types reads the previous
+  ///       tick's snapshot.
+  template<typename C, typename ARR>
+  auto comp_at(ARR* arr, size_t i)
+  {
+    using T = std::remove_pointer_t<C>;
+    if constexpr (std::is_const_v<T> && comp_layout_v<std::remove_const_t<T>> == CompLayout::buffered)
+      return arr->read_by_index(i);
+    else
+      return arr->get_by_index(i);
+  }
+
+  ///@brief Gets the component of the given entity for access as `C`, see
+  ///       `comp_at`.
+  template<typename C, typename ARR, typename ID_T>
+  auto comp_of(ARR* arr, ID_T id)
+  {
+    using T = std::remove_pointer_t<C>;
+    if constexpr (std::is_const_v<T> && comp_layout_v<std::remove_const_t<T>> == CompLayout::buffered)
+      return arr->read(id);
+    else
+      return arr->get(id);
+  }
+
+  ///@brief Gets the most recent value of the component of the given entity
+  ///       without writing to it. Unlike `get`, double-buffered types are
+  ///       not marked as written.
+  template<typename COMP, typename ARR, typename ID_T>
+  COMP const* comp_latest(ARR* arr, ID_T id)
+  {
+    if constexpr (comp_layout_v<COMP> == CompLayout::buffered)
+      return arr->latest(id);
+    else
+      return arr->get(id);
+  }
+
+  /// Entries swapped per `mem_defrag` step, between checks of the budget.
+  constexpr size_t defragStep = 1024;
+
   // TCompRegistry //////////////////////////////////////////////////////////////
   ///@brief Type that manages the association between component types and arrays
   ///       of component objects.
@@ -112,10 +728,145 @@ namespace __detail
     ///@brief    Removes all components corresponding to the given id
     ///@param id The id to search for.
     void remove_all_of(ID_T id);
+
+    ///@brief  Reports the memory used by every component array.
+    ///@return One entry per component type in use.
+    std::vector<CompMemoryStats> memory_stats();
+
+    ///@brief        Shrinks component arrays starting at `cursor`.
+    ///@param cursor Registry position to resume from. Updated to the next
+    ///              array to shrink, or reset to 0 once every array has been
+    ///              visited.
+    ///@param count  Maximum number of arrays to shrink.
+    ///@return       True if the pass reached the end of the registry.
+    bool shrink(size_t& cursor, size_t count);
+
+    ///@brief       Moves every component held by `other` into this registry,
+    ///             leaving `other` empty.
+    ///@param other The registry to merge from.
+    void merge_from(TCompRegistry& other);
+
+    ///@brief       Copies every component of the given entity into `dst`.
+    ///@param id    The entity to copy from.
+    ///@param dst   The registry to copy into.
+    ///@param dstId The entity in `dst` to assign the copies to.
+    void copy_entity(ID_T id, TCompRegistry& dst, ID_T dstId);
+
+    ///@brief         Gives each of the entities `first` to `first + count - 1`
+    ///               a copy of every component `proto` holds for `protoId`.
+    ///@param proto   The registry holding the prototype components.
+    ///@param protoId The entity owning the prototype components.
+    ///@param first   The first entity to assign copies to.
+    ///@param count   Number of entities.
+    void instantiate(TCompRegistry const& proto, ID_T protoId, ID_T first, ID_T count);
+
+    ///@brief       Replaces the arrays of the given component types with copies
+    ///             of those in `other`, creating them as needed.
+    ///@param other The registry to copy from.
+    ///@param keys  Component type ids of the arrays to copy.
+    void assign_from(TCompRegistry& other, std::vector<uint32_t> const& keys);
+
+    ///@brief Swaps the buffers of every double-buffered array.
+    void swap_buffers();
+
+    ///@brief Switches every array that is not pinned to its suggested
+    ///       storage.
+    void adapt_storage();
+
+    ///@brief       Advances the defragmentation of the most joined array that
+    ///             is not sorted by entity id yet. An array's spare capacity
+    ///             is released once it is sorted.
+    ///@param count Number of entries to swap, see `TEntitySet::defrag_step`.
+    ///@return      False if every array is already sorted.
+    bool defrag(size_t count);
+
+    ///@brief Sorts every array in sorted mode that was reordered since it was
+    ///       last sorted.
+    void sort_kept();
+
+    ///@brief     Gets the array of the given component type id as a set of
+    ///           entity ids.
+    ///@param key The component type id.
+    ///@return    The set, or `nullptr` if the registry has no such array.
+    TEntitySet<ID_T>* find_set(uint32_t key);
   private:
     std::vector<std::unique_ptr<ICompArrayBase<ID_T> > > reg_;
   };
 
+  // TResourceRegistry //////////////////////////////////////////////////////////
+  using ResourceFamily = struct ResourceFamily_;
+
+  struct IResourceBase
+  {
+    virtual ~IResourceBase() = default;
+  };
+
+  ///@brief Slot holding the single instance of a resource type. The slot's
+  ///       address never changes once created, so it can be cached by systems
+  ///       even while the resource itself is replaced or removed.
+  template<typename RES>
+  class TResource : public IResourceBase
+  {
+  public:
+    ///@brief      Constructs the resource, replacing any existing instance.
+    ///@param args Arguments to construct the resource with.
+    ///@return     The new resource.
+    template<typename ...ARGS>
+    RES& emplace(ARGS&&... args);
+    ///@brief Destroys the held resource, if any.
+    void reset() { ptr_.reset(); }
+    ///@return The held resource. Returns `nullptr` if none is set.
+    RES* get() const { return ptr_.get(); }
+  private:
+    std::unique_ptr<RES> ptr_;
+  };
+
+  ///@brief Type that manages global, per-world state (clocks, input, config...)
+  ///       that does not belong to any entity.
+  class TResourceRegistry
+  {
+  public:
+    ///@brief  Gets the slot associated with a given resource type, creating it
+    ///        if needed.
+    ///@return Reference to the slot of the resource type.
+    template<typename RES>
+    TResource<RES>& get_slot();
+  private:
+    std::vector<std::unique_ptr<IResourceBase> > reg_;
+  };
+
+  // PipelineDeps ///////////////////////////////////////////////////////////////
+  ///@brief Component and resource types read by the pipelined systems of a
+  ///       world, which are copied for them every tick. See
+  ///       `TWorld::tick_pipelined`.
+  struct PipelineDeps
+  {
+    struct ResCopy
+    {
+      uint32_t key;
+      void (*copy)(TResourceRegistry& from, TResourceRegistry& to);
+    };
+
+    std::vector<uint32_t> comps; ///< Component type ids.
+    std::vector<ResCopy>  res;
+
+    ///@brief Records the types in the given lists, as found in
+    ///       `TSystem::CompTypesList` and `TSystem::ResTypesList`.
+    template<typename ...COMP, typename ...RES>
+    void add(std::tuple<COMP...>*, std::tuple<RES...>*);
+
+    ///@brief Copies every recorded resource from one registry into another.
+    void copy_res(TResourceRegistry& from, TResourceRegistry& to) const
+    {
+      for (ResCopy const& r : res)
+        r.copy(from, to);
+    }
+
+    ///@brief Copies one resource, or removes it from `to` if `from` has none.
+    template<typename RES>
+    static void copy_one(TResourceRegistry& from, TResourceRegistry& to);
+  };
+
   // TEntity ////////////////////////////////////////////////////////////////////
   ///@brief Wrapper type that holds the id of a given entity.
   template<typename ID_T>
@@ -134,10 +885,201 @@ namespace __detail
     constexpr static TEntity<ID_T> invalid() { return std::numeric_limits<ID_T>::max(); }
   };
 
+  // TCompHandle ////////////////////////////////////////////////////////////////
+  ///@brief Lightweight typed reference to the component of one entity. Stays
+  ///       valid across insertions and removals of other components, and
+  ///       resolves with a single map lookup.
+  template<typename COMP, typename ID_T>
+  class TCompHandle
+  {
+  public:
+    TCompHandle() = default;
+    TCompHandle(TCompArray<COMP, ID_T>* arr, ID_T id) : arr_{ arr }, id_{ id } {}
+
+    ///@return The component. Returns `nullptr` if the entity no longer has
+    ///        one or the handle is empty.
+    COMP* get() const { return arr_ ? arr_->get(id_) : nullptr; }
+    COMP* operator->() const { return get(); }
+    explicit operator bool() const { return get() != nullptr; }
+
+    ///@return The entity the handle refers to.
+    ID_T entity() const { return id_; }
+
+  private:
+    TCompArray<COMP, ID_T>* arr_ = nullptr;
+    ID_T                    id_ = std::numeric_limits<ID_T>::max();
+  };
+
+  // Joins //////////////////////////////////////////////////////////////////////
+  /// Number of driver entries resolved together by `join_arrays`.
+  constexpr size_t joinBatch = 32;
+
+  ///@brief      Matches the entities of the first component type against the
+  ///            other types. The driver array is walked in batches: the map
+  ///            slots of a whole batch are prefetched, then the indices are
+  ///            resolved and the dense rows prefetched, and only then is
+  ///            `func` called, so the dependent loads of a batch overlap.
+  ///            Pointer component types are optional and yield the index
+  ///            numeric_limits<size_t>::max() when missing. Components must
+  ///            not be added or removed from within `func`.
+  ///@param arrs  Tuple of pointers to the arrays of each component type.
+  ///@param func  Called as `func(ID_T entity, size_t const* indices)` with one
+  ///             index per component type for every match.
+  ///@param arena Scratch memory for sorted joins.
+  template<typename ID_T, typename ...COMP, typename ARRS, typename FUNC>
+  void join_arrays(ARRS& arrs, FUNC func, FrameArena& arena);
+
+  ///@brief       Sorted variant of `join_arrays`, used when every required
+  ///              array is in sorted mode and currently sorted. The driver's
+  ///              ids are intersected with each other required array in turn.
+  ///              Arrays are never reordered here.
+  ///@param arena  Holds the intermediate results, released before returning.
+  ///@return       False if the arrays do not qualify, in which case nothing
+  ///              was done.
+  template<typename ID_T, typename ...COMP, typename FUNC, typename ARRS>
+  bool join_sorted_arrays(FUNC& func, ARRS& arrs, FrameArena& arena);
+
+  ///@brief Calls `func` with every component of the given array.
+  template<typename T, typename ARR, typename FUNC>
+  void each_single_array(ARR& compArr, FUNC func);
+
+  ///@brief Calls `func` with the components of every entity that has all of
+  ///       the given types.
+  template<typename ID_T, typename ...COMP, typename ARRS, typename FUNC>
+  void each_arrays(ARRS& arrs, FUNC func, FrameArena& arena);
+
+  ///@brief Reduces every component of the given array with
+  ///       `parallel_transform_reduce`. Double-buffered types are read from
+  ///       their snapshot.
+  template<typename C, typename ARR, typename T, typename REDUCE, typename TRANSFORM>
+  T transform_reduce_array(ARR& arr, T init, REDUCE reduce, TRANSFORM transform);
+
+  template<size_t N>
+  struct ViewIndices;
+
+  ///@brief Join results shared by views of the same component types until
+  ///       `release` is called, at the end of a tick. Entries are keyed by
+  ///       the component type set and validated against the versions of the
+  ///       arrays they were computed from. Views share ownership of a result,
+  ///       and each entry joins again into its previous buffer once no view
+  ///       holds it any more.
+  class ViewCache
+  {
+  public:
+    ///@brief       Gets the join result of the given component types, joining
+    ///             again if there is none or the arrays changed since.
+    ///@param arrs  Tuple of pointers to the arrays of each component type.
+    ///@param arena Arena the temporaries of the join are allocated from.
+    ///             Left as it was found.
+    template<typename ID_T, typename ...COMP, typename ARRS>
+    std::shared_ptr<ViewIndices<sizeof...(COMP)> const> get(ARRS& arrs, FrameArena& arena);
+
+    ///@brief Invalidates every cached result. Buffers are kept for reuse.
+    void release()
+    {
+      for (Entry& entry : entries_)
+        entry.valid = false;
+    }
+
+  private:
+    struct Entry
+    {
+      std::shared_ptr<void> indices;
+      bool                  valid = false;
+      std::vector<uint64_t> versions;
+    };
+
+    std::vector<Entry> entries_;
+  };
+
   // TWorld /////////////////////////////////////////////////////////////////////
-  ///@brief Helper type used by TWorld.
-  template<typename ID_T>
+  ///@brief Helper type used by the world types to run systems.
+  template<typename WORLD>
   struct SystemPackage;
+  template<typename WORLD>
+  struct SystemBase;
+
+  template<typename ID_T>
+  class TWorld;
+
+  template<typename ID_T, typename ...COMPS>
+  class TStaticWorld;
+
+  // TStagingBuffer /////////////////////////////////////////////////////////////
+  ///@brief Per-thread buffer for creating entities and components off the main
+  ///       thread. Ids are reserved from the world in blocks, components are
+  ///       kept in the buffer's own arrays until `TWorld::staging_merge` moves
+  ///       them into the world at a sync point. A buffer must only be used by
+  ///       one thread at a time.
+  template<typename ID_T>
+  class TStagingBuffer
+  {
+  public:
+    using Entity = TEntity<ID_T>;
+
+    /// Default number of ids reserved at once, clamped for small id types.
+    static constexpr ID_T defaultBlockSize = static_cast<ID_T>(
+      std::min<uint64_t>(256, std::numeric_limits<ID_T>::max() / 4));
+
+    ///@param world     The world entities are created for.
+    ///@param blockSize Number of ids reserved from the world at once.
+    explicit TStagingBuffer(TWorld<ID_T>& world, ID_T blockSize = defaultBlockSize)
+      : world_{ world }, blockSize_{ blockSize > 0 ? blockSize : ID_T{ 1 } } {}
+
+    ///@brief Gets the ID of a new entity. Thread-safe with respect to other
+    ///       buffers and the world.
+    Entity entity_new();
+
+    ///@brief      Stages a component for the given entity, constructed using
+    ///            the given arguments. The entity may be one created by this
+    ///            buffer or one that already exists in the world.
+    ///@param e    The entity ID to attach the component to.
+    ///@param args The arguments to pass to the component's constructor.
+    template<typename COMP, typename ...ARGS>
+    void comp_add(Entity e, ARGS&&... args);
+
+  private:
+    friend class TWorld<ID_T>;
+
+    TWorld<ID_T>&       world_;
+    TCompRegistry<ID_T> compReg_;
+    ID_T                blockSize_;
+    ID_T                next_ = 0;
+    ID_T                end_ = 0;
+  };
+
+  // TPrefab ////////////////////////////////////////////////////////////////////
+  ///@brief Set of components that entities can be created from in bulk with
+  ///       `TWorld::prefab_instantiate`. The prefab owns its components, so
+  ///       changes to the entity it was captured from do not affect it.
+  ///       Components must be copy constructible to be instantiated.
+  template<typename ID_T>
+  class TPrefab
+  {
+  public:
+    ///@brief      Sets the component of the given type, replacing any existing
+    ///            one.
+    ///@param args The arguments to pass to the component's constructor.
+    template<typename COMP, typename ...ARGS>
+    void comp_add(ARGS&&... args);
+
+    ///@brief Removes the component of the given type, if present.
+    template<typename COMP>
+    void comp_remove();
+
+    ///@return Non-owning pointer to the component of the given type, or
+    ///        `nullptr` if the prefab has none.
+    template<typename COMP>
+    COMP* comp_get();
+
+  private:
+    friend class TWorld<ID_T>;
+
+    /// Id the components are stored under in the prefab's own registry.
+    static constexpr ID_T protoId = 0;
+
+    TCompRegistry<ID_T> compReg_;
+  };
 
   ///@brief Type that wraps the functionality of the ECS system into a single
   ///       interface and provides support for operating on components.
@@ -166,10 +1108,52 @@ namespace __detail
     TWorld() = default;
     TWorld(TWorld const&) = delete;
     TWorld(TWorld&&) = delete;
-    ~TWorld() = default;
+    ~TWorld();
+
+    /// Buffer used to create entities and components from worker threads.
+    using StagingBuffer = TStagingBuffer<ID_T>;
+
+    ///@brief Gets the ID of a new entity. Must only be called from the thread
+    ///       that owns the world, use a `StagingBuffer` on other threads.
+    Entity entity_new()
+    {
+      if (nextId_ == idBlockEnd_)
+      {
+        nextId_ = entity_reserve(idBlockSize);
+        idBlockEnd_ = nextId_ + idBlockSize;
+      }
+      return nextId_++;
+    }
+
+    ///@brief       Reserves a contiguous range of entity ids. Thread-safe.
+    ///@param count Number of ids to reserve.
+    ///@return      The first id of the range.
+    ID_T entity_reserve(ID_T count)
+    {
+      return nextFree_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    ///@brief     Moves all entities and components staged in the buffer into
+    ///           the world and empties it. Must be called from the thread that
+    ///           owns the world while no other thread uses the buffer.
+    ///@param buf The buffer to merge.
+    void staging_merge(StagingBuffer& buf);
+
+    /// Component set that entities can be created from in bulk.
+    using Prefab = TPrefab<ID_T>;
 
-    ///@brief Gets the ID of a new entity.
-    Entity entity_new() { return lastUsed_++; }
+    ///@brief   Captures the components of the given entity.
+    ///@param e The entity to copy the components of.
+    ///@return  A prefab holding a copy of each component.
+    Prefab prefab_capture(Entity e);
+
+    ///@brief        Creates entities that each get a copy of every component of
+    ///              the prefab. The ids are reserved as one contiguous range and
+    ///              every component array grows once for the whole batch.
+    ///@param prefab The prefab to instantiate.
+    ///@param count  Number of entities to create.
+    ///@return       The first new entity. The others follow it in id order.
+    Entity prefab_instantiate(Prefab const& prefab, ID_T count = 1);
 
     ///@brief   Removes all components assigned to the given entity.
     ///         `entity_destroy_delayed` should generally be used instead of 
@@ -206,11 +1190,28 @@ namespace __detail
     template<typename COMP>
     COMP* comp_get(Entity e);
 
-    ///@brief  Returns the array of all components of type `COMP`.
+    ///@brief   Gets the component of the given type from the given entity for
+    ///         reading only. Double-buffered types yield the same value as
+    ///         `comp_get`, but are not marked as written, so the read does
+    ///         not cost a copy of the array on the next write.
+    ///@param e The entity ID to get from.
+    ///@return  Non-owning pointer to the attached component, or `nullptr`.
+    template<typename COMP>
+    COMP const* comp_latest(Entity e);
+
+    ///@brief  Returns the array of all components of type `COMP`. Not
+    ///        available for empty (tag) component types, which have no
+    ///        storage; use `comp_get_entities` for those.
     ///@return Array view of all components of type `COMP`.
     template<typename COMP>
     TArrayView<COMP> comp_get();
 
+    ///@brief  Returns the ids of all entities with a component of type `COMP`,
+    ///        in the same order as the array returned by `comp_get`.
+    ///@return Array view of entity ids.
+    template<typename COMP>
+    TArrayView<ID_T> comp_get_entities();
+
     ///@brief       Gets the entity that owns component of type `COMP` of
     ///             the given index.
     ///@param index The index of the component being tested.
@@ -229,6 +1230,144 @@ namespace __detail
     template<typename COMP>
     Entity comp_get_entity(COMP& comp);
 
+    ///@brief      Sets the world's resource of type `RES`, replacing any
+    ///            existing one.
+    ///@param args The arguments to pass to the resource's constructor.
+    ///@return     The new resource.
+    template<typename RES, typename ...ARGS>
+    RES& res_set(ARGS&&... args);
+
+    ///@brief  Gets the world's resource of type `RES`.
+    ///@return Non-owning pointer to the resource. If it has not been set,
+    ///        `nullptr` is returned.
+    template<typename RES>
+    RES* res_get();
+
+    ///@brief Destroys the world's resource of type `RES`, if set.
+    template<typename RES>
+    void res_remove();
+
+    ///@brief  Gets the slot holding the resource of type `RES`. Used by
+    ///        systems to bind their resource dependencies once.
+    template<typename RES>
+    TResource<RES>& res_slot();
+
+    ///@brief Sorts the components of type `COMP` by entity id. This changes
+    ///       the order of the array returned by `comp_get`.
+    template<typename COMP>
+    void comp_sort();
+
+    ///@brief      Sets whether the components of type `COMP` are kept sorted by
+    ///            entity id. When every required component of a join is kept
+    ///            sorted, `each` and `view_get` intersect the sorted id lists
+    ///            instead of probing each entity. Arrays changed during a
+    ///            tick are re-sorted at its end, and probed until then.
+    ///@param keep True to keep the array sorted.
+    template<typename COMP>
+    void comp_keep_sorted(bool keep = true);
+
+    ///@brief         Switches the id mapping of the components of type `COMP`.
+    ///               The array is rebuilt in place and keeps its order. The
+    ///               type is no longer changed by `comp_auto_storage`.
+    ///@param storage The mapping to use.
+    template<typename COMP>
+    void comp_set_storage(CompStorage storage);
+
+    ///@return The id mapping currently used by the components of type `COMP`.
+    template<typename COMP>
+    CompStorage comp_storage();
+
+    ///@brief        Sets whether every component array switches to the storage
+    ///              suggested by its occupancy at the end of each tick. Types
+    ///              with a storage in their `CompTraits` or set with
+    ///              `comp_set_storage` are left alone. The suggestions are
+    ///              also reported by `mem_stats` while this is off.
+    ///@param enable True to adapt storage automatically.
+    void comp_auto_storage(bool enable = true) { autoStorage_ = enable; }
+
+    ///@brief  Reports per component type memory usage.
+    ///@return One entry per component type in use.
+    std::vector<CompMemoryStats> mem_stats();
+
+    ///@brief      Creates a secondary index over the member `FIELD` of a
+    ///            component type, as in `index_add<&Unit::team>()`. The index
+    ///            is built from the existing components and kept up to date by
+    ///            `comp_add`, `comp_remove`, `entity_destroy`, `staging_merge`
+    ///            and `prefab_instantiate`. Fields changed through component
+    ///            references must be reported with `comp_changed`. Adding an
+    ///            index that already exists does nothing.
+    ///@param kind `CompIndex::hash` for equality lookups, `CompIndex::ordered`
+    ///            for ranges. A field may have both.
+    template<auto FIELD>
+    void index_add(CompIndex kind = CompIndex::hash);
+
+    ///@brief     Finds the entities whose `FIELD` equals the given key, using
+    ///           the hash index of the field. The index is created on first
+    ///           use if it was not added before.
+    ///@param key The value to look for.
+    ///@return    Array view of the entity ids, in no particular order. Only
+    ///           valid until the index next changes.
+    template<auto FIELD>
+    TArrayView<ID_T> index_find(FieldKeyT<FIELD> const& key);
+
+    ///@brief      Calls `func(Entity)` for every entity whose `FIELD` lies in
+    ///            `[lo, hi]`, ascending by key, using the ordered index of the
+    ///            field. If the function returns `bool`, iteration stops at the
+    ///            first `false`. The index is created on first use if it was
+    ///            not added before.
+    ///@param lo   The lowest key to include.
+    ///@param hi   The highest key to include.
+    ///@param func The function to be executed. Must not change the field.
+    template<auto FIELD, typename FUNC>
+    void index_range(FieldKeyT<FIELD> const& lo, FieldKeyT<FIELD> const& hi, FUNC func);
+
+    ///@brief      Executes a given function on the components of the given
+    ///            types of every entity whose `FIELD` equals the key and that
+    ///            has all of them, as `each` does for every entity.
+    ///@param key  The value to look for.
+    ///@param func The function to be executed. Must not change the field.
+    template<auto FIELD, typename ...COMP, typename FUNC>
+    void index_each(FieldKeyT<FIELD> const& key, FUNC func);
+
+    ///@brief   Updates the indexes over fields of `COMP` after the component
+    ///         of the given entity was changed through a reference.
+    ///@param e The entity whose component changed.
+    template<typename COMP>
+    void comp_changed(Entity e);
+
+    ///@brief Releases spare capacity of every component array at once.
+    void mem_shrink();
+
+    ///@brief        Incrementally releases spare capacity, shrinking component
+    ///              arrays one at a time until the budget is spent. Successive
+    ///              calls resume where the previous one stopped.
+    ///@param budget Time to spend. At least one array is always processed.
+    ///@return       True if a full pass over the registry was completed.
+    bool mem_compact(std::chrono::microseconds budget);
+
+    ///@brief        Incrementally sorts component arrays by entity id, undoing
+    ///              the scattering left behind by removals so that joins walk
+    ///              memory in order again. The arrays joined most often by
+    ///              `each` and `view_get` are sorted first, and each array's
+    ///              spare capacity is released once it is sorted. Work is done
+    ///              in small steps, successive calls resume where the
+    ///              previous one stopped.
+    ///@param budget Time to spend. At least one step is always taken.
+    ///@return       True if every array is sorted.
+    bool mem_defrag(std::chrono::microseconds budget);
+
+    ///@brief        Sets the time spent on `mem_defrag` at the end of every
+    ///              tick.
+    ///@param budget Time per tick. Zero, the default, turns it off.
+    void mem_set_defrag_budget(std::chrono::microseconds budget) { defragBudget_ = budget; }
+
+    ///@brief   Gets a handle to the component of type `COMP` of the given
+    ///         entity. Resolving the handle skips the registry lookup.
+    ///@param e The entity the handle refers to.
+    ///@return  The handle.
+    template<typename COMP>
+    TCompHandle<COMP, ID_T> comp_handle(Entity e);
+
     ///@brief      Adds a system to be executed on the given event type.
     ///@param evT  The type of event that fires the system.
     ///@param args Arguments that are forwarded to the system's constructor
@@ -242,33 +1381,132 @@ namespace __detail
     template<typename ...COMP, typename FUNC>
     void each(FUNC func);
 
-    ///@brief Calls all systems bound to tick events.
+    ///@brief        Reduces the components of type `COMP`, in parallel for
+    ///              large arrays. The result is reproducible bit for bit for
+    ///              a given set of components, see `parallel_transform_reduce`.
+    ///@param init   Value the reduction starts from.
+    ///@param reduce Called as `reduce(T, T)`. Must be thread-safe.
+    ///@return       The reduced value.
+    template<typename COMP, typename T, typename REDUCE>
+    T reduce(T init, REDUCE reduce);
+
+    ///@brief           Transforms every matching set of the given component
+    ///                 types into a `T` and reduces the results, as `reduce`.
+    ///@param init      Value the reduction starts from.
+    ///@param reduce    Called as `reduce(T, T)`. Must be thread-safe.
+    ///@param transform Takes each of the component types as const references
+    ///                 and returns a `T`. Must be thread-safe.
+    ///@return          The reduced value.
+    template<typename ...COMP, typename T, typename REDUCE, typename TRANSFORM>
+    T transform_reduce(T init, REDUCE reduce, TRANSFORM transform);
+
+    ///@brief Calls all systems bound to tick events. Coroutines spawned with
+    ///       `co_spawn` are resumed after the `tick` systems, within the
+    ///       coroutine budget, and at the sync point after the `tickEnd`
+    ///       systems. Resets the frame arena last.
     void tick();
 
-    ///@brief Gets a component view of the specified types.
+#ifdef ECS_HAS_COROUTINES
+    ///@brief      Hands a coroutine to the world. It first runs in the next
+    ///            tick's coroutine slot and is destroyed once it finishes.
+    ///@param task The coroutine to run.
+    void co_spawn(CoTask task) { coSched_.spawn(std::move(task)); }
+
+    ///@brief        Sets how long coroutines may run per tick. Coroutines only
+    ///              yield at their own suspension points, so this is a soft
+    ///              limit.
+    ///@param budget Time available to coroutines each tick.
+    void co_set_budget(std::chrono::microseconds budget) { coSched_.set_budget(budget); }
+
+    ///@return Number of coroutines that have not finished yet.
+    size_t co_count() const { return coSched_.count(); }
+
+    ///@brief  `co_await`ed to continue in the next tick.
+    __detail::CoScheduler::NextTick next_tick() { return { coSched_ }; }
+
+    ///@brief  `co_await`ed to continue at the end of the current tick, after
+    ///        every system has run.
+    __detail::CoScheduler::SyncPoint sync_point() { return { coSched_ }; }
+
+    ///@brief  `co_await`ed to continue in the next tick if this tick's
+    ///        coroutine budget is spent, or immediately otherwise.
+    __detail::CoScheduler::BudgetYield budget_yield() { return { coSched_ }; }
+#endif
+
+    ///@brief        Sets whether ticks are pipelined. `tickEnd` systems that
+    ///              only read the world, see `TSystem::readOnly`, then run on
+    ///              a pool thread while the next tick's `tickBegin` and
+    ///              `tick` systems run. They run after the other `tickEnd`
+    ///              systems, on a copy of the components and resources they
+    ///              read taken at that point, and `source()` returns the world
+    ///              holding that copy. Those types must be copyable. Each tick
+    ///              waits for the previous tick's systems before copying.
+    ///@param enable True to pipeline ticks.
+    void tick_pipelined(bool enable = true);
+
+    ///@brief Waits for the pipelined `tickEnd` systems of the previous tick,
+    ///       if any are running, and rethrows the first exception they threw.
+    void tick_wait();
+
+    ///@brief Gets a component view of the specified types. The join result is
+    ///       cached until the end of the tick and shared by every view of
+    ///       the same types, so systems with the same signature only join
+    ///       once. Adding, removing or reordering components of any of the
+    ///       types invalidates the cached result. Views keep the result they
+    ///       were created with and may be kept past the tick, but must not
+    ///       be used after their components are added, removed or moved.
     template<typename ...COMP>
     TComponentView<ID_T, COMP...> view_get();
 
-  private:
-    template<typename T, typename... T2>
-    friend class TComponentView;
+    ///@brief Gets the arena for temporary data, reset at the end of every
+    ///       tick. Systems can use it for scratch memory that does not
+    ///       outlive the tick, directly or through `TFrameAllocator`.
+    FrameArena& frame_arena() { return frameArena_; }
 
+    ///@brief Gets a lazily joined view of the specified types. Nothing is
+    ///       computed or allocated until the view is iterated.
+    template<typename ...COMP>
+    TLazyView<ID_T, COMP...> view_lazy();
 
-    template<typename T, typename FUNC>
-    void each_single(FUNC func);
+  private:
+    template<auto FIELD>
+    using HashIndex = THashIndex<FIELD, ID_T, TCompArray<FieldCompT<FIELD>, ID_T>>;
+    template<auto FIELD>
+    using OrderedIndex = TOrderedIndex<FIELD, ID_T, TCompArray<FieldCompT<FIELD>, ID_T>>;
 
-    template<typename FUNC, typename T, size_t... IS>
-    void each_func_exec(FUNC func, T args, std::index_sequence<IS...>);
+    /// Ids reserved at once by `entity_new`, so that it stays non-atomic.
+    /// Kept to a fraction of the id range so small id types still reserve.
+    static constexpr ID_T idBlockSize = static_cast<ID_T>(
+      std::min<uint64_t>(1024, std::numeric_limits<ID_T>::max() / 4));
 
-    template<typename COMP, typename FROM_COMP>
-    COMP* each_get_ptr(size_t i, TCompArray<FROM_COMP, ID_T>& fromCompArr, bool& noNull);
+    ///@brief Waits for the running pipelined systems, then copies what they
+    ///       read, and the list of those systems, and starts them on the
+    ///       shared worker pool.
+    void pipeline_start();
 
-    ID_T                              lastUsed_ = 0;
-    TCompRegistry<ID_T>               compReg_;
-    std::vector<SystemPackage<ID_T>>  sysTick_;
-    std::vector<SystemPackage<ID_T>>  sysTickBegin_;
-    std::vector<SystemPackage<ID_T>>  sysTickEnd_;
-    std::vector<Entity>               removeList_;
+    std::atomic<ID_T>                  nextFree_{ 0 };
+    ID_T                               nextId_ = 0;
+    ID_T                               idBlockEnd_ = 0;
+    TCompRegistry<ID_T>                compReg_;
+    TResourceRegistry                  resReg_;
+    TIndexRegistry<ID_T>               indexReg_;
+    size_t                             compactCursor_ = 0;
+    std::chrono::microseconds          defragBudget_{ 0 };
+    bool                               autoStorage_ = false;
+    std::vector<SystemPackage<TWorld>> sysTick_;
+    std::vector<SystemPackage<TWorld>> sysTickBegin_;
+    std::vector<SystemPackage<TWorld>> sysTickEnd_;
+    std::vector<Entity>                removeList_;
+    FrameArena                         frameArena_;
+    ViewCache                          viewCache_;
+    bool                               pipelined_ = false;
+    std::unique_ptr<TWorld>            pipeWorld_;
+    std::vector<SystemBase<TWorld>*>   pipeSystems_;
+    WorkerPool::Ticket                 pipeJob_;
+    PipelineDeps                       pipeDeps_;
+#ifdef ECS_HAS_COROUTINES
+    CoScheduler                        coSched_;
+#endif
   };
 
 } // namespace __detail
@@ -309,7 +1547,31 @@ namespace {
       i *= f;
     });
 
+    // Empty types act as tags. Only membership is stored for them, so they
+    // cost no memory per entity beyond the id mapping.
+    struct Visible {};
+    world.comp_add<Visible>(ent);
+    world.each<Visible, int32_t>([](Visible&, int32_t& i) {
+      printf("%i is visible\n", i);
+    });
+
+    // Components can be found by the value of a field through an index,
+    // instead of visiting every one of them.
+    struct Team { int32_t id; };
+    world.comp_add<Team>(ent, 3);
+    world.index_add<&Team::id>();
+    for (IdT e : world.index_find<&Team::id>(3))
+      printf("%u is on team 3\n", e);
+
+    // Scratch memory that is only needed until the end of the tick can be
+    // taken from the frame arena, which never frees it one allocation at a
+    // time.
+    std::vector<float, TFrameAllocator<float>> scratch{ world.frame_arena() };
+    world.each<float>([&](float& f) { scratch.push_back(f); });
+
     // The primary way of working with components is through Systems.
     // See system.hpp.
+
+    // Component state can be sent to other worlds. See replication.hpp.
   }
 }